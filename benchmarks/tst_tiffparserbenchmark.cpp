@@ -0,0 +1,205 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#include "tifffile.h"
+#include "tiffgenerator.h"
+#include <QTemporaryDir>
+#include <QtTest>
+
+class TiffParserBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void parse_data();
+    void parse();
+    void parseValues_data();
+    void parseValues();
+    void parseData_data();
+    void parseData();
+
+private:
+    void addFiles(bool fromFile = true);
+    bool writeFile(const QString &name, const TiffGeneratorOptions &options);
+
+    QTemporaryDir m_dir;
+};
+
+bool TiffParserBenchmark::writeFile(const QString &name, const TiffGeneratorOptions &options)
+{
+    TiffGenerator generator(options);
+    return generator.writeFile(m_dir.filePath(name));
+}
+
+void TiffParserBenchmark::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    TiffGeneratorOptions smallOptions;
+    QVERIFY(writeFile("small.tif", smallOptions));
+
+    TiffGeneratorOptions wideOptions;
+    wideOptions.entriesPerIfd = 2000;
+    wideOptions.arrayLength = 100000;
+    QVERIFY(writeFile("wide.tif", wideOptions));
+
+    TiffGeneratorOptions deepOptions;
+    deepOptions.pageCount = 20000;
+    QVERIFY(writeFile("deep.tif", deepOptions));
+
+    TiffGeneratorOptions subIfdsOptions;
+    subIfdsOptions.pageCount = 1000;
+    subIfdsOptions.subIfdCount = 2;
+    subIfdsOptions.subIfdDepth = 2;
+    QVERIFY(writeFile("subifds.tif", subIfdsOptions));
+
+    TiffGeneratorOptions scatteredOptions;
+    scatteredOptions.pageCount = 10000;
+    scatteredOptions.arrayLength = 16;
+    scatteredOptions.valuePlacement = TiffGeneratorOptions::ScatteredValues;
+    QVERIFY(writeFile("scattered.tif", scatteredOptions));
+
+    auto bigTiffOptions = wideOptions;
+    bigTiffOptions.bigTiff = true;
+    bigTiffOptions.byteOrder = TiffFile::BigEndian;
+    QVERIFY(writeFile("bigtiff.tif", bigTiffOptions));
+}
+
+/*
+ * Rows of the parser options for each file, the memory map rows only when the file
+ * is parsed \a fromFile. The threads rows parse the ifds with one thread per core.
+ */
+void TiffParserBenchmark::addFiles(bool fromFile)
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<bool>("useMemoryMap");
+    QTest::addColumn<bool>("prefetchValues");
+    QTest::addColumn<int>("parserThreadCount");
+
+    const QStringList names{ "small", "wide", "deep", "subifds", "scattered", "bigtiff" };
+    foreach (const auto name, names) {
+        QTest::newRow(qPrintable(name)) << name + ".tif" << false << false << 1;
+        if (fromFile)
+            QTest::newRow(qPrintable(name + "-mmap")) << name + ".tif" << true << false << 1;
+        QTest::newRow(qPrintable(name + "-prefetch")) << name + ".tif" << false << true << 1;
+        QTest::newRow(qPrintable(name + "-threads")) << name + ".tif" << false << false << 0;
+    }
+}
+
+void TiffParserBenchmark::parse_data()
+{
+    addFiles();
+}
+
+/*
+ * Header, ifds and entry tables, values are loaded on demand.
+ */
+void TiffParserBenchmark::parse()
+{
+    QFETCH(QString, fileName);
+    QFETCH(bool, useMemoryMap);
+    QFETCH(bool, prefetchValues);
+    QFETCH(int, parserThreadCount);
+
+    TiffParserOptions options;
+    options.useMemoryMap = useMemoryMap;
+    options.prefetchValues = prefetchValues;
+    options.parserThreadCount = parserThreadCount;
+    const auto filePath = m_dir.filePath(fileName);
+
+    QBENCHMARK {
+        TiffFile tiff(filePath, options);
+        QVERIFY(!tiff.hasError());
+        QVERIFY(!tiff.ifds().isEmpty());
+    }
+}
+
+void TiffParserBenchmark::parseValues_data()
+{
+    addFiles();
+}
+
+/*
+ * Same as parse(), but the values of all the entries are loaded too.
+ */
+void TiffParserBenchmark::parseValues()
+{
+    QFETCH(QString, fileName);
+    QFETCH(bool, useMemoryMap);
+    QFETCH(bool, prefetchValues);
+    QFETCH(int, parserThreadCount);
+
+    TiffParserOptions options;
+    options.useMemoryMap = useMemoryMap;
+    options.prefetchValues = prefetchValues;
+    options.parserThreadCount = parserThreadCount;
+    const auto filePath = m_dir.filePath(fileName);
+
+    QBENCHMARK {
+        TiffFile tiff(filePath, options);
+        qsizetype valueCount = 0; // valueCount() loads the values
+        foreach (const auto ifd, tiff.ifds()) {
+            foreach (const auto de, ifd.ifdEntries())
+                valueCount += de.valueCount();
+        }
+        QVERIFY(valueCount > 0);
+    }
+}
+
+void TiffParserBenchmark::parseData_data()
+{
+    addFiles(false);
+}
+
+/*
+ * Same as parseValues(), but from a file which is already in memory.
+ */
+void TiffParserBenchmark::parseData()
+{
+    QFETCH(QString, fileName);
+    QFETCH(bool, prefetchValues);
+    QFETCH(int, parserThreadCount);
+
+    TiffParserOptions options;
+    options.prefetchValues = prefetchValues;
+    options.parserThreadCount = parserThreadCount;
+    QFile file(m_dir.filePath(fileName));
+    QVERIFY(file.open(QFile::ReadOnly));
+    const auto data = file.readAll();
+
+    QBENCHMARK {
+        const auto tiff = TiffFile::fromData(data, options);
+        qsizetype valueCount = 0;
+        foreach (const auto ifd, tiff.ifds()) {
+            foreach (const auto de, ifd.ifdEntries())
+                valueCount += de.valueCount();
+        }
+        QVERIFY(valueCount > 0);
+    }
+}
+
+QTEST_GUILESS_MAIN(TiffParserBenchmark)
+
+#include "tst_tiffparserbenchmark.moc"
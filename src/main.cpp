@@ -23,7 +23,9 @@
 **
 ****************************************************************************/
 #include "mainwindow.h"
+#include "tifftrace.h"
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QLoggingCategory>
 #include <QSettings>
 
@@ -38,8 +40,25 @@ int main(int argc, char *argv[])
     QLoggingCategory::setFilterRules("*.debug=false");
     qSetMessagePattern("[%{time yyyyMMdd h:mm:ss.zzz t} %{category} %{type}: %{message}");
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("file", "Tiff file to open.", "[file]");
+    QCommandLineOption traceOption("trace", "Write a trace of parsing and populating the tree.",
+                                   "out.json");
+    parser.addOption(traceOption);
+    parser.process(a);
+
+    if (parser.isSet(traceOption))
+        TiffTrace::start();
+
     MainWindow w;
     w.show();
+    if (!parser.positionalArguments().isEmpty())
+        w.openTiffFile(parser.positionalArguments().first());
 
-    return a.exec();
+    const int ret = a.exec();
+    if (parser.isSet(traceOption) && !TiffTrace::writeFile(parser.value(traceOption)))
+        qWarning("Fail to write trace file %s", qPrintable(parser.value(traceOption)));
+    return ret;
 }
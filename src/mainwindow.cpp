@@ -26,14 +26,22 @@
 #include "ui_mainwindow.h"
 #include "optionsdialog.h"
 #include "tifffile.h"
+#include "tifftreemodel.h"
+#include "tifftrace.h"
 #include <QCloseEvent>
 #include <QFileInfo>
 #include <QSettings>
 #include <QApplication>
 #include <QFileDialog>
+#include <QFileSystemWatcher>
+#include <QHeaderView>
 #include <QMessageBox>
-#include <QTreeWidgetItem>
-#include <QFontMetricsF>
+#include <QProgressBar>
+#include <QThreadPool>
+#include <QTimer>
+
+// Time spent populating the tree before going back to the event loop.
+static const int g_populateTimeSlice = 20;
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -41,6 +49,40 @@ MainWindow::MainWindow(QWidget *parent)
 {
     ui->setupUi(this);
 
+    m_treeModel = new TiffTreeModel(this);
+    ui->treeView->setModel(m_treeModel);
+    connect(m_treeModel, &QAbstractItemModel::rowsInserted, this,
+            &MainWindow::onTreeRowsInserted);
+    // values summaries are just long enough to fill the value column
+    connect(ui->treeView->header(), &QHeaderView::sectionResized, this,
+            [this](int section, int, int newSize) {
+                if (section == 1)
+                    m_treeModel->setSummaryLength(
+                        newSize / qMax(ui->treeView->fontMetrics().averageCharWidth(), 1) + 1);
+            });
+
+    // ifd items are appended from the event loop, a batch at a time
+    m_populateTimer = new QTimer(this);
+    m_populateTimer->setInterval(0);
+    connect(m_populateTimer, &QTimer::timeout, this, &MainWindow::populateMoreIfds);
+    m_progressBar = new QProgressBar(this);
+    m_progressBar->setMaximumWidth(200);
+    m_progressBar->setVisible(false);
+    ui->statusBar->addPermanentWidget(m_progressBar);
+
+    // A file which is being written changes many times per page, so it's refreshed
+    // at most once per interval. The timer isn't restarted by later changes, which
+    // would delay the refresh for as long as the file keeps changing.
+    m_fileWatcher = new QFileSystemWatcher(this);
+    m_refreshTimer = new QTimer(this);
+    m_refreshTimer->setSingleShot(true);
+    m_refreshTimer->setInterval(500);
+    connect(m_fileWatcher, &QFileSystemWatcher::fileChanged, this, [this]() {
+        if (!m_refreshTimer->isActive())
+            m_refreshTimer->start();
+    });
+    connect(m_refreshTimer, &QTimer::timeout, this, &MainWindow::refreshTiffFile);
+
     // create action for recent files
     for (int i = 0; i < MaxRecentFiles; ++i) {
         auto act = new QAction(this);
@@ -54,17 +96,14 @@ MainWindow::MainWindow(QWidget *parent)
     m_actionSeparator->setVisible(false);
 
     connect(ui->actionOpen, &QAction::triggered, this, &MainWindow::onActionOpenTriggered);
+    connect(ui->actionStop, &QAction::triggered, this, &MainWindow::stopPopulating);
+    connect(ui->actionWatch, &QAction::toggled, this, &MainWindow::updateFileWatcher);
     connect(ui->actionExit, &QAction::triggered, qApp, &QApplication::quit);
     connect(ui->actionOptions, &QAction::triggered, this, &MainWindow::onActionOptionsTriggered);
     connect(ui->actionAbout, &QAction::triggered, this, &MainWindow::onActionAboutTriggered);
     connect(ui->actionAboutQt, &QAction::triggered, this, [this]() { QMessageBox::aboutQt(this); });
 
     loadSettings();
-    if (qApp->arguments().size() > 1) {
-        auto filePath = qApp->arguments().value(1);
-        if (QFileInfo::exists((filePath)))
-            doOpenTiffFile(filePath);
-    }
 }
 
 MainWindow::~MainWindow()
@@ -92,9 +131,12 @@ void MainWindow::onActionOptionsTriggered()
 {
     OptionsDialog dlg(this);
     dlg.setParserOptions(m_parserOptions);
+    dlg.setParseCacheEnabled(m_parseCacheEnabled);
 
-    if (dlg.exec() == QDialog::Accepted)
+    if (dlg.exec() == QDialog::Accepted) {
         m_parserOptions = dlg.parserOptions();
+        m_parseCacheEnabled = dlg.isParseCacheEnabled();
+    }
 }
 
 void MainWindow::onActionAboutTriggered()
@@ -146,6 +188,9 @@ void MainWindow::loadSettings()
 
     settings.beginGroup("parser");
     m_parserOptions.parserSubIfds = settings.value("parsersubifds", true).toBool();
+    m_parserOptions.useMemoryMap = settings.value("usememorymap", false).toBool();
+    m_parserOptions.parserThreadCount = settings.value("parserthreadcount", 1).toInt();
+    m_parseCacheEnabled = settings.value("parsecache", true).toBool();
     settings.endGroup();
 
     m_recentFiles = settings.value("recentfiles").toStringList();
@@ -162,61 +207,169 @@ void MainWindow::saveSettings()
 
     settings.beginGroup("parser");
     settings.setValue("parsersubifds", m_parserOptions.parserSubIfds);
+    settings.setValue("usememorymap", m_parserOptions.useMemoryMap);
+    settings.setValue("parserthreadcount", m_parserOptions.parserThreadCount);
+    settings.setValue("parsecache", m_parseCacheEnabled);
     settings.endGroup();
 
     settings.setValue("recentfiles", m_recentFiles);
 }
 
+/*
+ * Opens the file given in the command line.
+ */
+void MainWindow::openTiffFile(const QString &filePath)
+{
+    if (QFileInfo::exists(filePath))
+        doOpenTiffFile(filePath);
+}
+
 void MainWindow::doOpenTiffFile(const QString &filePath)
 {
+    TIFF_TRACE_SPAN("openTiffFile");
     m_recentFiles.removeOne(filePath);
     m_recentFiles.insert(0, filePath);
     if (m_recentFiles.size() > MaxRecentFiles)
         m_recentFiles.removeLast();
     updateActionRecentFiles();
 
-    TiffFile tiff(filePath, m_parserOptions);
+    stopPopulating();
+
+    // Only the header is read here, ifds are parsed in batches when they are added
+    // to the tree, and each batch is parsed with the parser threads of the options.
+    auto options = m_parserOptions;
+    options.parseIfdsOnDemand = true;
+    options.cache = m_parseCacheEnabled ? &m_parseCache : nullptr;
+    // a watched file may still be written, its last ifd is read when it changes
+    options.growingFile = ui->actionWatch->isChecked();
+    QSharedPointer<TiffFile> tiff(new TiffFile(filePath, options));
 
-    ui->treeWidget->clear();
+    m_treeModel->clear();
+    updateFileWatcher();
 
-    if (tiff.hasError()) {
+    if (tiff->hasError()) {
         ui->logEdit->appendPlainText(
-            QString("Fail to open the tiff file: %1 [%2]").arg(filePath).arg(tiff.errorString()));
+            QString("Fail to open the tiff file: %1 [%2]").arg(filePath).arg(tiff->errorString()));
         return;
     }
     setWindowTitle(tr("%1 - QtTiffTagViewer").arg(filePath));
 
-    // headeritem
-    {
-        auto headerItem = new QTreeWidgetItem(ui->treeWidget);
-        headerItem->setText(0, tr("Header"));
-        headerItem->setText(1, tiff.headerBytes().toHex(' '));
-        headerItem->setExpanded(true);
-
-        auto childItem = new QTreeWidgetItem(headerItem);
-
-        childItem->setText(0, tr("ByteOrder"));
-        childItem->setText(1,
-                           QString("%1 (%2)")
-                               .arg(tiff.headerBytes().left(2))
-                               .arg(tiff.byteOrder() == TiffFile::BigEndian ? tr("BigEndian")
-                                                                            : tr("LittleEndian")));
-
-        childItem = new QTreeWidgetItem(headerItem);
-        childItem->setText(0, tr("Version"));
-        childItem->setText(1,
-                           QString("%1 (%2)")
-                               .arg(tiff.version())
-                               .arg(tiff.isBigTiff() ? "BigTiff" : "Classic Tiff"));
-
-        childItem = new QTreeWidgetItem(headerItem);
-        childItem->setText(0, tr("IFD0Offset"));
-        childItem->setText(1, QString::number(tiff.ifd0Offset()));
+    // Items are created by the model when the view asks for them. The header
+    // and IFD0 are shown at once, other ifds are appended in the background.
+    m_treeModel->setTiffFile(tiff);
+    m_treeModel->fetchMoreIfds(QDeadlineTimer(0));
+    updateFileWatcher();
+    startPopulating();
+}
+
+void MainWindow::startPopulating()
+{
+    auto tiff = m_treeModel->tiffFile();
+    if (!tiff || !m_treeModel->canFetchMore(QModelIndex())) {
+        logParseResult();
+        saveParseCache();
+        return;
+    }
+
+    updateProgressBar();
+    m_progressBar->setVisible(true);
+    ui->statusBar->showMessage(tr("Loading ifds..."));
+    ui->actionStop->setEnabled(true);
+    m_populateTimer->start();
+}
+
+/*
+ * Stops populating in the background, the remaining ifds are still loaded when
+ * the view is scrolled to the end.
+ */
+void MainWindow::stopPopulating()
+{
+    if (!m_populateTimer->isActive())
+        return;
+
+    m_populateTimer->stop();
+    m_progressBar->setVisible(false);
+    ui->statusBar->clearMessage();
+    ui->actionStop->setEnabled(false);
+    logParseResult();
+}
+
+/*
+ * Errors of ifds parsed on demand and the cost of parsing are only known once
+ * the tree is populated.
+ */
+void MainWindow::logParseResult()
+{
+    auto tiff = m_treeModel->tiffFile();
+    if (!tiff)
+        return;
+
+    if (tiff->hasError())
+        ui->logEdit->appendPlainText(QString("Error found when parsing the tiff file: %1")
+                                         .arg(tiff->errorString()));
+    if (tiff->isLoadedFromCache())
+        ui->logEdit->appendPlainText(QString("Ifds are restored from the parse cache"));
+
+    const auto stats = tiff->stats();
+    auto ms = [](qint64 nsecs) { return QString::number(nsecs / 1000000.0, 'f', 2); };
+    ui->logEdit->appendPlainText(
+        QString("Parsed %1 ifds and %2 entries: %3 read in %4 calls, %5 seeks, "
+                "%6 value fetches, %7 peak value memory; "
+                "wall time: header %8 ms, directories %9 ms, values %10 ms; "
+                "cpu time: directories %11 ms, values %12 ms")
+            .arg(stats.ifdCount)
+            .arg(stats.entryCount)
+            .arg(locale().formattedDataSize(stats.bytesRead))
+            .arg(stats.readCalls)
+            .arg(stats.seeks)
+            .arg(stats.valueFetches)
+            .arg(locale().formattedDataSize(stats.peakValueMemory))
+            .arg(ms(stats.headerNsecs), ms(stats.directoryNsecs), ms(stats.valueDecodeNsecs),
+                 ms(stats.directoryCpuNsecs), ms(stats.valueDecodeCpuNsecs)));
+}
+
+void MainWindow::populateMoreIfds()
+{
+    TIFF_TRACE_SPAN("populateMoreIfds");
+    ui->treeView->setUpdatesEnabled(false);
+    m_treeModel->fetchMoreIfds(QDeadlineTimer(g_populateTimeSlice));
+    ui->treeView->setUpdatesEnabled(true);
+
+    updateProgressBar();
+    if (!m_treeModel->canFetchMore(QModelIndex())) {
+        stopPopulating();
+        saveParseCache();
     }
+}
+
+/*
+ * The number of ifds is only known once the ifd chain has been scanned, which is
+ * done while the tree is populated, so the progress bar is busy until then.
+ */
+void MainWindow::updateProgressBar()
+{
+    auto tiff = m_treeModel->tiffFile();
+    const bool scanned = tiff && tiff->isIfdChainScanned();
+    m_progressBar->setRange(0, scanned ? tiff->scanIfdChain(0) : 0);
+    m_progressBar->setValue(m_treeModel->ifdItemCount());
+}
+
+/*
+ * Caches the file once all its ifds are in the tree, so that it opens without
+ * being parsed next time. A copy of the file is written to the cache in the
+ * background, while the tree keeps using the file.
+ */
+void MainWindow::saveParseCache()
+{
+    auto tiff = m_treeModel->tiffFile();
+    // files which are still being written are not worth caching
+    if (!m_parseCacheEnabled || !tiff || tiff->hasError() || tiff->isLoadedFromCache()
+        || ui->actionWatch->isChecked())
+        return;
 
-    // IfdItem
-    foreach (const auto ifd, tiff.ifds())
-        fillSubIfdItem(nullptr, ifd);
+    QSharedPointer<TiffFile> copy(new TiffFile(tiff->clone()));
+    QThreadPool::globalInstance()->start(
+        [cache = m_parseCache, copy]() mutable { cache.insert(*copy); });
 }
 
 void MainWindow::updateActionRecentFiles()
@@ -232,96 +385,72 @@ void MainWindow::updateActionRecentFiles()
     m_actionSeparator->setVisible(count > 0);
 }
 
-void MainWindow::fillIfdEntryItem(QTreeWidgetItem *parentItem, const TiffIfdEntry &de)
+/*
+ * The header and ifd items are expanded as soon as they are inserted, as the items
+ * are created on demand, this is deferred until the model has finished inserting.
+ */
+void MainWindow::onTreeRowsInserted(const QModelIndex &parent, int first, int last)
 {
-    const auto tagName = de.tagName();
-    QStringList valueStrings;
-    foreach (auto v, de.values()) {
-        auto valueString = v.toString();
-        if (v.typeId() == QMetaType::QString) {
-            valueString.replace(QLatin1String("\r"), QLatin1String("\\r"));
-            valueString.replace(QLatin1String("\n"), QLatin1String("\\n"));
-            valueString.replace(QLatin1String("\t"), QLatin1String("\\t"));
-            valueString.replace(QLatin1String("\v"), QLatin1String("\\v"));
-            valueString.replace(QLatin1String("\b"), QLatin1String("\\b"));
-        }
-        valueStrings.append(valueString);
-    }
-    auto valueString = valueStrings.join(" ");
-    valueString =
-        QFontMetricsF(ui->treeWidget->font()).elidedText(valueString, Qt::ElideRight, 400);
-    auto vd = de.valueDescription();
-    if (!vd.isEmpty())
-        valueString = QString("%1 [%2]").arg(valueString, vd);
-
-    auto deItem = new QTreeWidgetItem(parentItem);
-    deItem->setText(0, tr("DE %1").arg(tagName));
-    deItem->setText(1,
-                    QString("Type=%2, Count=%3, Values=%4")
-                        .arg(de.typeName())
-                        .arg(de.count())
-                        .arg(valueString));
-
-    auto item = new QTreeWidgetItem(deItem);
-    item->setText(0, tr("Tag"));
-    item->setText(1, QString("%1 %2").arg(tagName).arg(de.tag()));
-
-    item = new QTreeWidgetItem(deItem);
-    item->setText(0, tr("DataType"));
-    item->setText(1, QString("%1 %2").arg(de.typeName()).arg(de.type()));
-
-    item = new QTreeWidgetItem(deItem);
-    item->setText(0, tr("Count"));
-    item->setText(1, QString::number(de.count()));
-
-    item = new QTreeWidgetItem(deItem);
-    item->setText(0, tr("ValueOrOffset"));
-    item->setText(1, de.valueOrOffset().toHex(' '));
-
-    item = new QTreeWidgetItem(deItem);
-    item->setText(0, tr("Values"));
-    item->setText(1, valueString);
-    for (auto i = 0; i < valueStrings.size(); ++i) {
-        auto valueItem = new QTreeWidgetItem(item);
-        valueItem->setText(0, tr("Value[%1]").arg(i));
-        valueItem->setText(1, valueStrings[i]);
+    for (int row = first; row <= last; ++row) {
+        auto index = m_treeModel->index(row, 0, parent);
+        if (m_treeModel->isExpandedByDefault(index))
+            m_pendingExpandIndexes.append(index);
     }
+    if (!m_pendingExpandIndexes.isEmpty())
+        QTimer::singleShot(0, this, &MainWindow::expandPendingItems);
 }
 
-void MainWindow::fillSubIfdItem(QTreeWidgetItem *parentItem, const TiffIfd &ifd)
+void MainWindow::expandPendingItems()
 {
-    auto ifdItem = new QTreeWidgetItem(parentItem);
-    if (!parentItem)
-        ui->treeWidget->addTopLevelItem(ifdItem);
-
-    ifdItem->setText(0, tr("IFD"));
-    ifdItem->setText(1, "");
-    ifdItem->setExpanded(true);
-
-    int width = -1;
-    int height = -1;
-
-    auto childItem = new QTreeWidgetItem(ifdItem);
-    childItem->setText(0, tr("EntriesCount"));
-    childItem->setText(1, QString::number(ifd.ifdEntries().size()));
-
-    // ifd entity items
-    foreach (const auto de, ifd.ifdEntries()) {
-        fillIfdEntryItem(ifdItem, de);
-        if (de.tag() == TiffIfdEntry::T_ImageWidth)
-            width = de.values().value(0).toInt();
-        if (de.tag() == TiffIfdEntry::T_ImageLength)
-            height = de.values().value(0).toInt();
+    const auto indexes = m_pendingExpandIndexes;
+    m_pendingExpandIndexes.clear();
+    foreach (const auto index, indexes) {
+        if (index.isValid())
+            ui->treeView->expand(index);
     }
+}
+
+/*
+ * Watches the opened file when the Watch action is checked.
+ */
+void MainWindow::updateFileWatcher()
+{
+    m_refreshTimer->stop();
+    if (!m_fileWatcher->files().isEmpty())
+        m_fileWatcher->removePaths(m_fileWatcher->files());
 
-    // sub ifd items
-    foreach (const auto subIfd, ifd.subIfds())
-        fillSubIfdItem(ifdItem, subIfd);
+    auto tiff = m_treeModel->tiffFile();
+    if (ui->actionWatch->isChecked() && tiff && !tiff->filePath().isEmpty())
+        m_fileWatcher->addPath(tiff->filePath());
+}
 
-    childItem = new QTreeWidgetItem(ifdItem);
-    childItem->setText(0, tr("NextIFDOffset"));
-    childItem->setText(1, QString::number(ifd.nextIfdOffset()));
+/*
+ * Appends the ifds which have been linked since the file was opened or refreshed.
+ * Only the new ifds are read, so this doesn't depend on the size of the file.
+ */
+void MainWindow::refreshTiffFile()
+{
+    TIFF_TRACE_SPAN("refreshTiffFile");
+    auto tiff = m_treeModel->tiffFile();
+    if (!tiff)
+        return;
+    // Some writers replace the file, which removes it from the watcher. The new file
+    // may have nothing in common with the old one, so it's opened again.
+    if (m_fileWatcher->files().isEmpty()) {
+        const auto filePath = tiff->filePath();
+        if (QFileInfo::exists(filePath)) {
+            ui->logEdit->appendPlainText(QString("%1 has been replaced").arg(filePath));
+            doOpenTiffFile(filePath);
+        }
+        return;
+    }
 
-    if (width != -1 && height != -1)
-        ifdItem->setText(1, tr("Image(%1x%2)").arg(width).arg(height));
+    const int count = m_treeModel->refresh();
+    if (count == 0)
+        return;
+    ui->logEdit->appendPlainText(QString("%1 new ifds found").arg(count));
+    if (m_populateTimer->isActive())
+        updateProgressBar();
+    else
+        startPopulating();
 }
@@ -25,9 +25,14 @@
 #pragma once
 
 #include "tifffile.h"
+#include "tiffparsecache.h"
 #include <QMainWindow>
+#include <QPersistentModelIndex>
 
-class QTreeWidgetItem;
+class TiffTreeModel;
+class QFileSystemWatcher;
+class QProgressBar;
+class QTimer;
 
 namespace Ui {
 class MainWindow;
@@ -41,6 +46,8 @@ public:
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    void openTiffFile(const QString &filePath);
+
 protected:
     void closeEvent(QCloseEvent *evt);
 
@@ -54,13 +61,28 @@ private:
     void saveSettings();
     void doOpenTiffFile(const QString &filePath);
     void updateActionRecentFiles();
-
-    void fillIfdEntryItem(QTreeWidgetItem *parentItem, const TiffIfdEntry &de);
-    void fillSubIfdItem(QTreeWidgetItem *parentItem, const TiffIfd &ifd);
+    void onTreeRowsInserted(const QModelIndex &parent, int first, int last);
+    void expandPendingItems();
+    void startPopulating();
+    void stopPopulating();
+    void populateMoreIfds();
+    void updateProgressBar();
+    void logParseResult();
+    void saveParseCache();
+    void updateFileWatcher();
+    void refreshTiffFile();
 
     Ui::MainWindow *ui;
+    TiffTreeModel *m_treeModel;
+    QList<QPersistentModelIndex> m_pendingExpandIndexes;
+    QTimer *m_populateTimer;
+    QProgressBar *m_progressBar;
+    QFileSystemWatcher *m_fileWatcher;
+    QTimer *m_refreshTimer;
 
     TiffParserOptions m_parserOptions;
+    TiffParseCache m_parseCache;
+    bool m_parseCacheEnabled{ true };
 
     enum { MaxRecentFiles = 10 };
     QAction *m_actionRecentFiles[MaxRecentFiles];
@@ -41,10 +41,24 @@ TiffParserOptions OptionsDialog::parserOptions() const
 {
     TiffParserOptions options;
     options.parserSubIfds = ui->parser_subIfds_button->isChecked();
+    options.useMemoryMap = ui->parser_memoryMap_button->isChecked();
+    options.parserThreadCount = ui->parser_threadCount_spinBox->value();
     return options;
 }
 
 void OptionsDialog::setParserOptions(const TiffParserOptions &options)
 {
     ui->parser_subIfds_button->setChecked(options.parserSubIfds);
+    ui->parser_memoryMap_button->setChecked(options.useMemoryMap);
+    ui->parser_threadCount_spinBox->setValue(options.parserThreadCount);
+}
+
+bool OptionsDialog::isParseCacheEnabled() const
+{
+    return ui->parser_cache_button->isChecked();
+}
+
+void OptionsDialog::setParseCacheEnabled(bool enabled)
+{
+    ui->parser_cache_button->setChecked(enabled);
 }
@@ -42,6 +42,8 @@ public:
 
     TiffParserOptions parserOptions() const;
     void setParserOptions(const TiffParserOptions &options);
+    bool isParseCacheEnabled() const;
+    void setParseCacheEnabled(bool enabled);
 
 private:
     Ui::OptionsDialog *ui;
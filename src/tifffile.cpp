@@ -23,267 +23,388 @@
 **
 ****************************************************************************/
 #include "tifffile.h"
+#include "tiffparsecache.h"
+#include "tiffstreambuffer.h"
+#include "tifftrace.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QPointer>
+#include <QSemaphore>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
 #include <QLoggingCategory>
 #include <QtEndian>
 #include <QSharedData>
 #include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
 
 Q_LOGGING_CATEGORY(tiffLog, "dbzhang800.tiffFile")
 
-const static char *g_dataTypeName[] = { nullptr,     "BYTE",  "ASCII",     "SHORT",  "LONG",
-                                        "RATIONAL",  "SBYTE", "UNDEFINED", "SSHORT", "SLONG",
-                                        "SRATIONAL", "FLOAT", "DOUBLE",    "IFD",    "LONG8",
-                                        "SLONG8",    "IFD8" };
-
-const static QMap<int, QByteArray> g_tagNames = {
-    { 254, "SUBFILETYPE" },
-    { 255, "OSUBFILETYPE" },
-    { 256, "IMAGEWIDTH" },
-    { 257, "IMAGELENGTH" },
-    { 258, "BITSPERSAMPLE" },
-    { 259, "COMPRESSION" },
-    { 262, "PHOTOMETRIC" },
-    { 263, "THRESHHOLDING" },
-    { 264, "CELLWIDTH" },
-    { 265, "CELLLENGTH" },
-    { 266, "FILLORDER" },
-    { 269, "DOCUMENTNAME" },
-    { 270, "IMAGEDESCRIPTION" },
-    { 271, "MAKE" },
-    { 272, "MODEL" },
-    { 273, "STRIPOFFSETS" },
-    { 274, "ORIENTATION" },
-    { 277, "SAMPLESPERPIXEL" },
-    { 278, "ROWSPERSTRIP" },
-    { 279, "STRIPBYTECOUNTS" },
-    { 280, "MINSAMPLEVALUE" },
-    { 281, "MAXSAMPLEVALUE" },
-    { 282, "XRESOLUTION" },
-    { 283, "YRESOLUTION" },
-    { 284, "PLANARCONFIG" },
-    { 285, "PAGENAME" },
-    { 286, "XPOSITION" },
-    { 287, "YPOSITION" },
-    { 288, "FREEOFFSETS" },
-    { 289, "FREEBYTECOUNTS" },
-    { 290, "GRAYRESPONSEUNIT" },
-    { 291, "GRAYRESPONSECURVE" },
-    { 292, "GROUP3OPTIONS" },
-    { 292, "T4OPTIONS" },
-    { 293, "GROUP4OPTIONS" },
-    { 293, "T6OPTIONS" },
-    { 296, "RESOLUTIONUNIT" },
-    { 297, "PAGENUMBER" },
-    { 300, "COLORRESPONSEUNIT" },
-    { 301, "TRANSFERFUNCTION" },
-    { 305, "SOFTWARE" },
-    { 306, "DATETIME" },
-    { 315, "ARTIST" },
-    { 316, "HOSTCOMPUTER" },
-    { 317, "PREDICTOR" },
-    { 318, "WHITEPOINT" },
-    { 319, "PRIMARYCHROMATICITIES" },
-    { 320, "COLORMAP" },
-    { 321, "HALFTONEHINTS" },
-    { 322, "TILEWIDTH" },
-    { 323, "TILELENGTH" },
-    { 324, "TILEOFFSETS" },
-    { 325, "TILEBYTECOUNTS" },
-    { 326, "BADFAXLINES" },
-    { 327, "CLEANFAXDATA" },
-    { 328, "CONSECUTIVEBADFAXLINES" },
-    { 330, "SUBIFD" },
-    { 332, "INKSET" },
-    { 333, "INKNAMES" },
-    { 334, "NUMBEROFINKS" },
-    { 336, "DOTRANGE" },
-    { 337, "TARGETPRINTER" },
-    { 338, "EXTRASAMPLES" },
-    { 339, "SAMPLEFORMAT" },
-    { 340, "SMINSAMPLEVALUE" },
-    { 341, "SMAXSAMPLEVALUE" },
-    { 343, "CLIPPATH" },
-    { 344, "XCLIPPATHUNITS" },
-    { 345, "YCLIPPATHUNITS" },
-    { 346, "INDEXED" },
-    { 347, "JPEGTABLES" },
-    { 351, "OPIPROXY" },
-    { 400, "GLOBALPARAMETERSIFD" },
-    { 401, "PROFILETYPE" },
-    { 402, "FAXPROFILE" },
-    { 403, "CODINGMETHODS" },
-    { 404, "VERSIONYEAR" },
-    { 405, "MODENUMBER" },
-    { 433, "DECODE" },
-    { 434, "IMAGEBASECOLOR" },
-    { 435, "T82OPTIONS" },
-    { 512, "JPEGPROC" },
-    { 513, "JPEGIFOFFSET" },
-    { 514, "JPEGIFBYTECOUNT" },
-    { 515, "JPEGRESTARTINTERVAL" },
-    { 517, "JPEGLOSSLESSPREDICTORS" },
-    { 518, "JPEGPOINTTRANSFORM" },
-    { 519, "JPEGQTABLES" },
-    { 520, "JPEGDCTABLES" },
-    { 521, "JPEGACTABLES" },
-    { 529, "YCBCRCOEFFICIENTS" },
-    { 530, "YCBCRSUBSAMPLING" },
-    { 531, "YCBCRPOSITIONING" },
-    { 532, "REFERENCEBLACKWHITE" },
-    { 559, "STRIPROWCOUNTS" },
-    { 700, "XMLPACKET" },
-    { 32781, "OPIIMAGEID" },
-    { 32932, "TIFFANNOTATIONDATA" },
-    { 32953, "REFPTS" },
-    { 32954, "REGIONTACKPOINT" },
-    { 32955, "REGIONWARPCORNERS" },
-    { 32956, "REGIONAFFINE" },
-    { 32995, "MATTEING" },
-    { 32996, "DATATYPE" },
-    { 32997, "IMAGEDEPTH" },
-    { 32998, "TILEDEPTH" },
-    { 33300, "PIXAR_IMAGEFULLWIDTH" },
-    { 33301, "PIXAR_IMAGEFULLLENGTH" },
-    { 33302, "PIXAR_TEXTUREFORMAT" },
-    { 33303, "PIXAR_WRAPMODES" },
-    { 33304, "PIXAR_FOVCOT" },
-    { 33305, "PIXAR_MATRIX_WORLDTOSCREEN" },
-    { 33306, "PIXAR_MATRIX_WORLDTOCAMERA" },
-    { 33405, "WRITERSERIALNUMBER" },
-    { 33421, "CFAREPEATPATTERNDIM" },
-    { 33422, "CFAPATTERN" },
-    { 33432, "COPYRIGHT" },
-    { 33445, "MD_FILETAG" },
-    { 33446, "MD_SCALEPIXEL" },
-    { 33447, "MD_COLORTABLE" },
-    { 33448, "MD_LABNAME" },
-    { 33449, "MD_SAMPLEINFO" },
-    { 33450, "MD_PREPDATE" },
-    { 33451, "MD_PREPTIME" },
-    { 33452, "MD_FILEUNITS" },
-    { 33723, "RICHTIFFIPTC" },
-    { 33918, "INGR_PACKET_DATA_TAG" },
-    { 33919, "INGR_FLAG_REGISTERS" },
-    { 33920, "IRASB_TRANSORMATION_MATRIX" },
-    { 33922, "MODELTIEPOINTTAG" },
-    { 34016, "IT8SITE" },
-    { 34017, "IT8COLORSEQUENCE" },
-    { 34018, "IT8HEADER" },
-    { 34019, "IT8RASTERPADDING" },
-    { 34020, "IT8BITSPERRUNLENGTH" },
-    { 34021, "IT8BITSPEREXTENDEDR" },
-    { 34022, "IT8COLORTABLE" },
-    { 34023, "IT8IMAGECOLORINDICATOR" },
-    { 34024, "IT8BKGCOLORINDICATOR" },
-    { 34025, "IT8IMAGECOLORVALUE" },
-    { 34026, "IT8BKGCOLORVALUE" },
-    { 34027, "IT8PIXELINTENSITYRANGE" },
-    { 34028, "IT8TRANSPARENCYINDICATOR" },
-    { 34029, "IT8COLORCHARACTERIZATION" },
-    { 34030, "IT8HCUSAGE" },
-    { 34031, "IT8TRAPINDICATOR" },
-    { 34032, "IT8CMYKEQUIVALENT" },
-    { 34232, "FRAMECOUNT" },
-    { 34264, "MODELTRANSFORMATIONTAG" },
-    { 34377, "PHOTOSHOP" },
-    { 34665, "EXIFIFD" },
-    { 34675, "ICCPROFILE" },
-    { 34732, "IMAGELAYER" },
-    { 34750, "JBIGOPTIONS" },
-    { 34853, "GPSIFD" },
-    { 34908, "FAXRECVPARAMS" },
-    { 34909, "FAXSUBADDRESS" },
-    { 34910, "FAXRECVTIME" },
-    { 34911, "FAXDCS" },
-    { 37439, "STONITS" },
-    { 34929, "FEDEX_EDR" },
-    { 37724, "IMAGESOURCEDATA" },
-    { 40965, "INTEROPERABILITYIFD" },
-    { 42112, "GDAL_METADATA" },
-    { 42113, "GDAL_NODATA" },
-    { 50215, "OCE_SCANJOB_DESCRIPTION" },
-    { 50216, "OCE_APPLICATION_SELECTOR" },
-    { 50217, "OCE_IDENTIFICATION_NUMBER" },
-    { 50218, "OCE_IMAGELOGIC_CHARACTERISTICS" },
-    { 50674, "LERC_PARAMETERS" },
-    { 50706, "DNGVERSION" },
-    { 50707, "DNGBACKWARDVERSION" },
-    { 50708, "UNIQUECAMERAMODEL" },
-    { 50709, "LOCALIZEDCAMERAMODEL" },
-    { 50710, "CFAPLANECOLOR" },
-    { 50711, "CFALAYOUT" },
-    { 50712, "LINEARIZATIONTABLE" },
-    { 50713, "BLACKLEVELREPEATDIM" },
-    { 50714, "BLACKLEVEL" },
-    { 50715, "BLACKLEVELDELTAH" },
-    { 50716, "BLACKLEVELDELTAV" },
-    { 50717, "WHITELEVEL" },
-    { 50718, "DEFAULTSCALE" },
-    { 50719, "DEFAULTCROPORIGIN" },
-    { 50720, "DEFAULTCROPSIZE" },
-    { 50721, "COLORMATRIX1" },
-    { 50722, "COLORMATRIX2" },
-    { 50723, "CAMERACALIBRATION1" },
-    { 50724, "CAMERACALIBRATION2" },
-    { 50725, "REDUCTIONMATRIX1" },
-    { 50726, "REDUCTIONMATRIX2" },
-    { 50727, "ANALOGBALANCE" },
-    { 50728, "ASSHOTNEUTRAL" },
-    { 50729, "ASSHOTWHITEXY" },
-    { 50730, "BASELINEEXPOSURE" },
-    { 50731, "BASELINENOISE" },
-    { 50732, "BASELINESHARPNESS" },
-    { 50733, "BAYERGREENSPLIT" },
-    { 50734, "LINEARRESPONSELIMIT" },
-    { 50735, "CAMERASERIALNUMBER" },
-    { 50736, "LENSINFO" },
-    { 50737, "CHROMABLURRADIUS" },
-    { 50738, "ANTIALIASSTRENGTH" },
-    { 50739, "SHADOWSCALE" },
-    { 50740, "DNGPRIVATEDATA" },
-    { 50741, "MAKERNOTESAFETY" },
-    { 50778, "CALIBRATIONILLUMINANT1" },
-    { 50779, "CALIBRATIONILLUMINANT2" },
-    { 50780, "BESTQUALITYSCALE" },
-    { 50781, "RAWDATAUNIQUEID" },
-    { 50827, "ORIGINALRAWFILENAME" },
-    { 50828, "ORIGINALRAWFILEDATA" },
-    { 50829, "ACTIVEAREA" },
-    { 50830, "MASKEDAREAS" },
-    { 50831, "ASSHOTICCPROFILE" },
-    { 50832, "ASSHOTPREPROFILEMATRIX" },
-    { 50833, "CURRENTICCPROFILE" },
-    { 50834, "CURRENTPREPROFILEMATRIX" },
-    { 50844, "RPCCOEFFICIENT" },
-    { 50784, "ALIAS_LAYER_METADATA" },
-    { 50908, "TIFF_RSID" },
-    { 50909, "GEO_METADATA" },
-    { 50933, "EXTRACAMERAPROFILES" },
-    { 65535, "DCSHUESHIFTVALUES" },
-
-    // TAGS missing from libtiff
-    // GeoTIFF
-    { 33550, "MODELPIXELSCALETAG" },
-    { 34735, "GEOKEYDIRECTORYTAG" },
-    { 34736, "GEODOUBLEPARAMSTAG" },
-    { 34737, "GEOASCIIPARAMSTAG" },
+#define TIFF_LATIN1(name) QLatin1String(name, sizeof(name) - 1)
+#define TIFF_NAME(code, name) { code, TIFF_LATIN1(name), QLatin1String() }
+#define TIFF_NAME_ALIAS(code, name, alias) { code, TIFF_LATIN1(name), TIFF_LATIN1(alias) }
+
+static constexpr QLatin1String g_dataTypeNames[] = {
+    QLatin1String(),         TIFF_LATIN1("BYTE"),      TIFF_LATIN1("ASCII"),
+    TIFF_LATIN1("SHORT"),    TIFF_LATIN1("LONG"),      TIFF_LATIN1("RATIONAL"),
+    TIFF_LATIN1("SBYTE"),    TIFF_LATIN1("UNDEFINED"), TIFF_LATIN1("SSHORT"),
+    TIFF_LATIN1("SLONG"),    TIFF_LATIN1("SRATIONAL"), TIFF_LATIN1("FLOAT"),
+    TIFF_LATIN1("DOUBLE"),   TIFF_LATIN1("IFD"),       TIFF_LATIN1("LONG8"),
+    TIFF_LATIN1("SLONG8"),   TIFF_LATIN1("IFD8")
 };
 
-const static QMap<int, QByteArray> g_compressionNames = {
-    { 1, "NONE" },          { 2, "CCITTRLE" },      { 3, "CCITTFAX3" },
-    { 3, "CCITT_T4" },      { 4, "CCITTFAX4" },     { 4, "CCITT_T6" },
-    { 5, "LZW" },           { 6, "OJPEG" },         { 7, "JPEG" },
-    { 9, "T85" },           { 10, "T43" },          { 32766, "NEXT" },
-    { 32771, "CCITTRLEW" }, { 32773, "PACKBITS" },  { 32809, "THUNDERSCAN" },
-    { 32895, "IT8CTPAD" },  { 32896, "IT8LW" },     { 32897, "IT8MP" },
-    { 32898, "IT8BL" },     { 32908, "PIXARFILM" }, { 32909, "PIXARLOG" },
-    { 32946, "DEFLATE" },   { 8, "ADOBE_DEFLATE" }, { 32947, "DCS" },
-    { 34661, "JBIG" },      { 34676, "SGILOG" },    { 34677, "SGILOG24" },
-    { 34712, "JP2000" },    { 34887, "LERC" },      { 34925, "LZMA" },
-    { 50000, "ZSTD" },      { 50001, "WEBP" },      { 50002, "JXL" }
+struct TiffNameEntry
+{
+    int code;
+    QLatin1String name;
+    QLatin1String alias;
+};
+
+// Sorted by code, the name which was registered last is used for duplicated codes,
+// and the other one is kept as an alias.
+static constexpr TiffNameEntry g_tagNames[] = {
+    TIFF_NAME(254, "SUBFILETYPE"),
+    TIFF_NAME(255, "OSUBFILETYPE"),
+    TIFF_NAME(256, "IMAGEWIDTH"),
+    TIFF_NAME(257, "IMAGELENGTH"),
+    TIFF_NAME(258, "BITSPERSAMPLE"),
+    TIFF_NAME(259, "COMPRESSION"),
+    TIFF_NAME(262, "PHOTOMETRIC"),
+    TIFF_NAME(263, "THRESHHOLDING"),
+    TIFF_NAME(264, "CELLWIDTH"),
+    TIFF_NAME(265, "CELLLENGTH"),
+    TIFF_NAME(266, "FILLORDER"),
+    TIFF_NAME(269, "DOCUMENTNAME"),
+    TIFF_NAME(270, "IMAGEDESCRIPTION"),
+    TIFF_NAME(271, "MAKE"),
+    TIFF_NAME(272, "MODEL"),
+    TIFF_NAME(273, "STRIPOFFSETS"),
+    TIFF_NAME(274, "ORIENTATION"),
+    TIFF_NAME(277, "SAMPLESPERPIXEL"),
+    TIFF_NAME(278, "ROWSPERSTRIP"),
+    TIFF_NAME(279, "STRIPBYTECOUNTS"),
+    TIFF_NAME(280, "MINSAMPLEVALUE"),
+    TIFF_NAME(281, "MAXSAMPLEVALUE"),
+    TIFF_NAME(282, "XRESOLUTION"),
+    TIFF_NAME(283, "YRESOLUTION"),
+    TIFF_NAME(284, "PLANARCONFIG"),
+    TIFF_NAME(285, "PAGENAME"),
+    TIFF_NAME(286, "XPOSITION"),
+    TIFF_NAME(287, "YPOSITION"),
+    TIFF_NAME(288, "FREEOFFSETS"),
+    TIFF_NAME(289, "FREEBYTECOUNTS"),
+    TIFF_NAME(290, "GRAYRESPONSEUNIT"),
+    TIFF_NAME(291, "GRAYRESPONSECURVE"),
+    TIFF_NAME_ALIAS(292, "T4OPTIONS", "GROUP3OPTIONS"),
+    TIFF_NAME_ALIAS(293, "T6OPTIONS", "GROUP4OPTIONS"),
+    TIFF_NAME(296, "RESOLUTIONUNIT"),
+    TIFF_NAME(297, "PAGENUMBER"),
+    TIFF_NAME(300, "COLORRESPONSEUNIT"),
+    TIFF_NAME(301, "TRANSFERFUNCTION"),
+    TIFF_NAME(305, "SOFTWARE"),
+    TIFF_NAME(306, "DATETIME"),
+    TIFF_NAME(315, "ARTIST"),
+    TIFF_NAME(316, "HOSTCOMPUTER"),
+    TIFF_NAME(317, "PREDICTOR"),
+    TIFF_NAME(318, "WHITEPOINT"),
+    TIFF_NAME(319, "PRIMARYCHROMATICITIES"),
+    TIFF_NAME(320, "COLORMAP"),
+    TIFF_NAME(321, "HALFTONEHINTS"),
+    TIFF_NAME(322, "TILEWIDTH"),
+    TIFF_NAME(323, "TILELENGTH"),
+    TIFF_NAME(324, "TILEOFFSETS"),
+    TIFF_NAME(325, "TILEBYTECOUNTS"),
+    TIFF_NAME(326, "BADFAXLINES"),
+    TIFF_NAME(327, "CLEANFAXDATA"),
+    TIFF_NAME(328, "CONSECUTIVEBADFAXLINES"),
+    TIFF_NAME(330, "SUBIFD"),
+    TIFF_NAME(332, "INKSET"),
+    TIFF_NAME(333, "INKNAMES"),
+    TIFF_NAME(334, "NUMBEROFINKS"),
+    TIFF_NAME(336, "DOTRANGE"),
+    TIFF_NAME(337, "TARGETPRINTER"),
+    TIFF_NAME(338, "EXTRASAMPLES"),
+    TIFF_NAME(339, "SAMPLEFORMAT"),
+    TIFF_NAME(340, "SMINSAMPLEVALUE"),
+    TIFF_NAME(341, "SMAXSAMPLEVALUE"),
+    TIFF_NAME(343, "CLIPPATH"),
+    TIFF_NAME(344, "XCLIPPATHUNITS"),
+    TIFF_NAME(345, "YCLIPPATHUNITS"),
+    TIFF_NAME(346, "INDEXED"),
+    TIFF_NAME(347, "JPEGTABLES"),
+    TIFF_NAME(351, "OPIPROXY"),
+    TIFF_NAME(400, "GLOBALPARAMETERSIFD"),
+    TIFF_NAME(401, "PROFILETYPE"),
+    TIFF_NAME(402, "FAXPROFILE"),
+    TIFF_NAME(403, "CODINGMETHODS"),
+    TIFF_NAME(404, "VERSIONYEAR"),
+    TIFF_NAME(405, "MODENUMBER"),
+    TIFF_NAME(433, "DECODE"),
+    TIFF_NAME(434, "IMAGEBASECOLOR"),
+    TIFF_NAME(435, "T82OPTIONS"),
+    TIFF_NAME(512, "JPEGPROC"),
+    TIFF_NAME(513, "JPEGIFOFFSET"),
+    TIFF_NAME(514, "JPEGIFBYTECOUNT"),
+    TIFF_NAME(515, "JPEGRESTARTINTERVAL"),
+    TIFF_NAME(517, "JPEGLOSSLESSPREDICTORS"),
+    TIFF_NAME(518, "JPEGPOINTTRANSFORM"),
+    TIFF_NAME(519, "JPEGQTABLES"),
+    TIFF_NAME(520, "JPEGDCTABLES"),
+    TIFF_NAME(521, "JPEGACTABLES"),
+    TIFF_NAME(529, "YCBCRCOEFFICIENTS"),
+    TIFF_NAME(530, "YCBCRSUBSAMPLING"),
+    TIFF_NAME(531, "YCBCRPOSITIONING"),
+    TIFF_NAME(532, "REFERENCEBLACKWHITE"),
+    TIFF_NAME(559, "STRIPROWCOUNTS"),
+    TIFF_NAME(700, "XMLPACKET"),
+    TIFF_NAME(32781, "OPIIMAGEID"),
+    TIFF_NAME(32932, "TIFFANNOTATIONDATA"),
+    TIFF_NAME(32953, "REFPTS"),
+    TIFF_NAME(32954, "REGIONTACKPOINT"),
+    TIFF_NAME(32955, "REGIONWARPCORNERS"),
+    TIFF_NAME(32956, "REGIONAFFINE"),
+    TIFF_NAME(32995, "MATTEING"),
+    TIFF_NAME(32996, "DATATYPE"),
+    TIFF_NAME(32997, "IMAGEDEPTH"),
+    TIFF_NAME(32998, "TILEDEPTH"),
+    TIFF_NAME(33300, "PIXAR_IMAGEFULLWIDTH"),
+    TIFF_NAME(33301, "PIXAR_IMAGEFULLLENGTH"),
+    TIFF_NAME(33302, "PIXAR_TEXTUREFORMAT"),
+    TIFF_NAME(33303, "PIXAR_WRAPMODES"),
+    TIFF_NAME(33304, "PIXAR_FOVCOT"),
+    TIFF_NAME(33305, "PIXAR_MATRIX_WORLDTOSCREEN"),
+    TIFF_NAME(33306, "PIXAR_MATRIX_WORLDTOCAMERA"),
+    TIFF_NAME(33405, "WRITERSERIALNUMBER"),
+    TIFF_NAME(33421, "CFAREPEATPATTERNDIM"),
+    TIFF_NAME(33422, "CFAPATTERN"),
+    TIFF_NAME(33432, "COPYRIGHT"),
+    TIFF_NAME(33445, "MD_FILETAG"),
+    TIFF_NAME(33446, "MD_SCALEPIXEL"),
+    TIFF_NAME(33447, "MD_COLORTABLE"),
+    TIFF_NAME(33448, "MD_LABNAME"),
+    TIFF_NAME(33449, "MD_SAMPLEINFO"),
+    TIFF_NAME(33450, "MD_PREPDATE"),
+    TIFF_NAME(33451, "MD_PREPTIME"),
+    TIFF_NAME(33452, "MD_FILEUNITS"),
+    TIFF_NAME(33550, "MODELPIXELSCALETAG"), // GeoTIFF, missing from libtiff
+    TIFF_NAME(33723, "RICHTIFFIPTC"),
+    TIFF_NAME(33918, "INGR_PACKET_DATA_TAG"),
+    TIFF_NAME(33919, "INGR_FLAG_REGISTERS"),
+    TIFF_NAME(33920, "IRASB_TRANSORMATION_MATRIX"),
+    TIFF_NAME(33922, "MODELTIEPOINTTAG"),
+    TIFF_NAME(34016, "IT8SITE"),
+    TIFF_NAME(34017, "IT8COLORSEQUENCE"),
+    TIFF_NAME(34018, "IT8HEADER"),
+    TIFF_NAME(34019, "IT8RASTERPADDING"),
+    TIFF_NAME(34020, "IT8BITSPERRUNLENGTH"),
+    TIFF_NAME(34021, "IT8BITSPEREXTENDEDR"),
+    TIFF_NAME(34022, "IT8COLORTABLE"),
+    TIFF_NAME(34023, "IT8IMAGECOLORINDICATOR"),
+    TIFF_NAME(34024, "IT8BKGCOLORINDICATOR"),
+    TIFF_NAME(34025, "IT8IMAGECOLORVALUE"),
+    TIFF_NAME(34026, "IT8BKGCOLORVALUE"),
+    TIFF_NAME(34027, "IT8PIXELINTENSITYRANGE"),
+    TIFF_NAME(34028, "IT8TRANSPARENCYINDICATOR"),
+    TIFF_NAME(34029, "IT8COLORCHARACTERIZATION"),
+    TIFF_NAME(34030, "IT8HCUSAGE"),
+    TIFF_NAME(34031, "IT8TRAPINDICATOR"),
+    TIFF_NAME(34032, "IT8CMYKEQUIVALENT"),
+    TIFF_NAME(34232, "FRAMECOUNT"),
+    TIFF_NAME(34264, "MODELTRANSFORMATIONTAG"),
+    TIFF_NAME(34377, "PHOTOSHOP"),
+    TIFF_NAME(34665, "EXIFIFD"),
+    TIFF_NAME(34675, "ICCPROFILE"),
+    TIFF_NAME(34732, "IMAGELAYER"),
+    TIFF_NAME(34735, "GEOKEYDIRECTORYTAG"), // GeoTIFF, missing from libtiff
+    TIFF_NAME(34736, "GEODOUBLEPARAMSTAG"), // GeoTIFF, missing from libtiff
+    TIFF_NAME(34737, "GEOASCIIPARAMSTAG"), // GeoTIFF, missing from libtiff
+    TIFF_NAME(34750, "JBIGOPTIONS"),
+    TIFF_NAME(34853, "GPSIFD"),
+    TIFF_NAME(34908, "FAXRECVPARAMS"),
+    TIFF_NAME(34909, "FAXSUBADDRESS"),
+    TIFF_NAME(34910, "FAXRECVTIME"),
+    TIFF_NAME(34911, "FAXDCS"),
+    TIFF_NAME(34929, "FEDEX_EDR"),
+    TIFF_NAME(37439, "STONITS"),
+    TIFF_NAME(37724, "IMAGESOURCEDATA"),
+    TIFF_NAME(40965, "INTEROPERABILITYIFD"),
+    TIFF_NAME(42112, "GDAL_METADATA"),
+    TIFF_NAME(42113, "GDAL_NODATA"),
+    TIFF_NAME(50215, "OCE_SCANJOB_DESCRIPTION"),
+    TIFF_NAME(50216, "OCE_APPLICATION_SELECTOR"),
+    TIFF_NAME(50217, "OCE_IDENTIFICATION_NUMBER"),
+    TIFF_NAME(50218, "OCE_IMAGELOGIC_CHARACTERISTICS"),
+    TIFF_NAME(50674, "LERC_PARAMETERS"),
+    TIFF_NAME(50706, "DNGVERSION"),
+    TIFF_NAME(50707, "DNGBACKWARDVERSION"),
+    TIFF_NAME(50708, "UNIQUECAMERAMODEL"),
+    TIFF_NAME(50709, "LOCALIZEDCAMERAMODEL"),
+    TIFF_NAME(50710, "CFAPLANECOLOR"),
+    TIFF_NAME(50711, "CFALAYOUT"),
+    TIFF_NAME(50712, "LINEARIZATIONTABLE"),
+    TIFF_NAME(50713, "BLACKLEVELREPEATDIM"),
+    TIFF_NAME(50714, "BLACKLEVEL"),
+    TIFF_NAME(50715, "BLACKLEVELDELTAH"),
+    TIFF_NAME(50716, "BLACKLEVELDELTAV"),
+    TIFF_NAME(50717, "WHITELEVEL"),
+    TIFF_NAME(50718, "DEFAULTSCALE"),
+    TIFF_NAME(50719, "DEFAULTCROPORIGIN"),
+    TIFF_NAME(50720, "DEFAULTCROPSIZE"),
+    TIFF_NAME(50721, "COLORMATRIX1"),
+    TIFF_NAME(50722, "COLORMATRIX2"),
+    TIFF_NAME(50723, "CAMERACALIBRATION1"),
+    TIFF_NAME(50724, "CAMERACALIBRATION2"),
+    TIFF_NAME(50725, "REDUCTIONMATRIX1"),
+    TIFF_NAME(50726, "REDUCTIONMATRIX2"),
+    TIFF_NAME(50727, "ANALOGBALANCE"),
+    TIFF_NAME(50728, "ASSHOTNEUTRAL"),
+    TIFF_NAME(50729, "ASSHOTWHITEXY"),
+    TIFF_NAME(50730, "BASELINEEXPOSURE"),
+    TIFF_NAME(50731, "BASELINENOISE"),
+    TIFF_NAME(50732, "BASELINESHARPNESS"),
+    TIFF_NAME(50733, "BAYERGREENSPLIT"),
+    TIFF_NAME(50734, "LINEARRESPONSELIMIT"),
+    TIFF_NAME(50735, "CAMERASERIALNUMBER"),
+    TIFF_NAME(50736, "LENSINFO"),
+    TIFF_NAME(50737, "CHROMABLURRADIUS"),
+    TIFF_NAME(50738, "ANTIALIASSTRENGTH"),
+    TIFF_NAME(50739, "SHADOWSCALE"),
+    TIFF_NAME(50740, "DNGPRIVATEDATA"),
+    TIFF_NAME(50741, "MAKERNOTESAFETY"),
+    TIFF_NAME(50778, "CALIBRATIONILLUMINANT1"),
+    TIFF_NAME(50779, "CALIBRATIONILLUMINANT2"),
+    TIFF_NAME(50780, "BESTQUALITYSCALE"),
+    TIFF_NAME(50781, "RAWDATAUNIQUEID"),
+    TIFF_NAME(50784, "ALIAS_LAYER_METADATA"),
+    TIFF_NAME(50827, "ORIGINALRAWFILENAME"),
+    TIFF_NAME(50828, "ORIGINALRAWFILEDATA"),
+    TIFF_NAME(50829, "ACTIVEAREA"),
+    TIFF_NAME(50830, "MASKEDAREAS"),
+    TIFF_NAME(50831, "ASSHOTICCPROFILE"),
+    TIFF_NAME(50832, "ASSHOTPREPROFILEMATRIX"),
+    TIFF_NAME(50833, "CURRENTICCPROFILE"),
+    TIFF_NAME(50834, "CURRENTPREPROFILEMATRIX"),
+    TIFF_NAME(50844, "RPCCOEFFICIENT"),
+    TIFF_NAME(50908, "TIFF_RSID"),
+    TIFF_NAME(50909, "GEO_METADATA"),
+    TIFF_NAME(50933, "EXTRACAMERAPROFILES"),
+    TIFF_NAME(65535, "DCSHUESHIFTVALUES"),
+};
+
+static constexpr TiffNameEntry g_compressionNames[] = {
+    TIFF_NAME(1, "NONE"),
+    TIFF_NAME(2, "CCITTRLE"),
+    TIFF_NAME_ALIAS(3, "CCITT_T4", "CCITTFAX3"),
+    TIFF_NAME_ALIAS(4, "CCITT_T6", "CCITTFAX4"),
+    TIFF_NAME(5, "LZW"),
+    TIFF_NAME(6, "OJPEG"),
+    TIFF_NAME(7, "JPEG"),
+    TIFF_NAME(8, "ADOBE_DEFLATE"),
+    TIFF_NAME(9, "T85"),
+    TIFF_NAME(10, "T43"),
+    TIFF_NAME(32766, "NEXT"),
+    TIFF_NAME(32771, "CCITTRLEW"),
+    TIFF_NAME(32773, "PACKBITS"),
+    TIFF_NAME(32809, "THUNDERSCAN"),
+    TIFF_NAME(32895, "IT8CTPAD"),
+    TIFF_NAME(32896, "IT8LW"),
+    TIFF_NAME(32897, "IT8MP"),
+    TIFF_NAME(32898, "IT8BL"),
+    TIFF_NAME(32908, "PIXARFILM"),
+    TIFF_NAME(32909, "PIXARLOG"),
+    TIFF_NAME(32946, "DEFLATE"),
+    TIFF_NAME(32947, "DCS"),
+    TIFF_NAME(34661, "JBIG"),
+    TIFF_NAME(34676, "SGILOG"),
+    TIFF_NAME(34677, "SGILOG24"),
+    TIFF_NAME(34712, "JP2000"),
+    TIFF_NAME(34887, "LERC"),
+    TIFF_NAME(34925, "LZMA"),
+    TIFF_NAME(50000, "ZSTD"),
+    TIFF_NAME(50001, "WEBP"),
+    TIFF_NAME(50002, "JXL"),
+};
+
+/*
+ * Lookup of a name table. Codes below DenseCodeCount, which are most of the
+ * baseline tags, are found through an index built at compile time, the others
+ * by a binary search.
+ */
+template <std::size_t N>
+class TiffNameTable
+{
+public:
+    enum { DenseCodeCount = 1024 };
+
+    constexpr TiffNameTable(const TiffNameEntry (&entries)[N])
+        : m_entries(entries)
+        , m_denseIndex()
+    {
+        for (std::size_t i = 0; i < DenseCodeCount; ++i)
+            m_denseIndex[i] = -1;
+        for (std::size_t i = 0; i < N; ++i) {
+            if (entries[i].code < DenseCodeCount)
+                m_denseIndex[entries[i].code] = static_cast<qint16>(i);
+        }
+    }
+
+    constexpr bool isSorted() const
+    {
+        for (std::size_t i = 1; i < N; ++i) {
+            if (m_entries[i - 1].code >= m_entries[i].code)
+                return false;
+        }
+        return true;
+    }
+
+    const TiffNameEntry *find(int code) const
+    {
+        if (code >= 0 && code < DenseCodeCount) {
+            const int index = m_denseIndex[code];
+            return index == -1 ? nullptr : &m_entries[index];
+        }
+        auto it = std::lower_bound(
+            std::begin(m_entries), std::end(m_entries), code,
+            [](const TiffNameEntry &entry, int code) { return entry.code < code; });
+        return it != std::end(m_entries) && it->code == code ? it : nullptr;
+    }
+
+    QLatin1String name(int code) const
+    {
+        auto entry = find(code);
+        return entry ? entry->name : QLatin1String();
+    }
+
+    QLatin1String alias(int code) const
+    {
+        auto entry = find(code);
+        return entry ? entry->alias : QLatin1String();
+    }
+
+private:
+    const TiffNameEntry (&m_entries)[N];
+    std::array<qint16, DenseCodeCount> m_denseIndex;
 };
 
+static constexpr TiffNameTable<std::size(g_tagNames)> g_tagNameTable(g_tagNames);
+static constexpr TiffNameTable<std::size(g_compressionNames)> g_compressionNameTable(
+    g_compressionNames);
+static_assert(g_tagNameTable.isSorted(), "tag names must be sorted by code");
+static_assert(g_compressionNameTable.isSorted(), "compression names must be sorted by code");
+
+// Format of TiffFile::cacheData()
+static const quint32 CacheDataVersion = 2;
+
 template <typename T>
 static inline T getValueFromBytes(const char *bytes, TiffFile::ByteOrder byteOrder)
 {
@@ -292,71 +413,838 @@ static inline T getValueFromBytes(const char *bytes, TiffFile::ByteOrder byteOrd
     return qFromBigEndian<T>(reinterpret_cast<const uchar *>(bytes));
 }
 
-template <typename T>
-static inline T fixValueByteOrder(T value, TiffFile::ByteOrder byteOrder)
+/*
+ * Converts count values to host byte order in one pass. Qt uses vectorized
+ * byte swapping kernels for this when the cpu supports them.
+ */
+template <TiffFile::ByteOrder Order, typename T>
+static inline void getValuesFromBytes(const char *bytes, qsizetype count, void *dest)
 {
-    if (byteOrder == TiffFile::LittleEndian)
-        return qFromLittleEndian<T>(value);
-    return qFromBigEndian<T>(value);
+    if constexpr (Order == TiffFile::LittleEndian)
+        qFromLittleEndian<T>(bytes, count, dest);
+    else
+        qFromBigEndian<T>(bytes, count, dest);
 }
 
-class TiffIfdEntryPrivate : public QSharedData
+/*
+ * Field sizes and decoders of one tiff flavour. The directory parser is
+ * instantiated for each byte order and offset width once the header is read,
+ * so fields are decoded without testing the flavour each time.
+ */
+template <TiffFile::ByteOrder Order, bool BigTiff>
+struct TiffLayout
 {
-public:
-    TiffIfdEntryPrivate() {}
-    TiffIfdEntryPrivate(const TiffIfdEntryPrivate &other)
-        : QSharedData(other)
-        , tag(other.tag)
-        , type(other.type)
-        , count(other.count)
-        , valueOrOffset(other.valueOrOffset)
+    static constexpr TiffFile::ByteOrder byteOrder = Order;
+    static constexpr int countSize = BigTiff ? 8 : 2;
+    static constexpr int entrySize = BigTiff ? 20 : 12;
+    static constexpr int offsetSize = BigTiff ? 8 : 4;
+
+    template <typename T>
+    static T get(const char *bytes)
     {
+        if constexpr (Order == TiffFile::LittleEndian)
+            return qFromLittleEndian<T>(bytes);
+        else
+            return qFromBigEndian<T>(bytes);
     }
-    ~TiffIfdEntryPrivate() {}
 
-    int typeSize()
+    // number of entries of an ifd
+    static quint64 entryCount(const char *bytes)
     {
-        switch (type) {
-        case TiffIfdEntry::DT_Byte:
-        case TiffIfdEntry::DT_SByte:
-        case TiffIfdEntry::DT_Ascii:
-        case TiffIfdEntry::DT_Undefined:
-            return 1;
-        case TiffIfdEntry::DT_Short:
-        case TiffIfdEntry::DT_SShort:
-            return 2;
-        case TiffIfdEntry::DT_Long:
-        case TiffIfdEntry::DT_SLong:
-        case TiffIfdEntry::DT_Ifd:
-        case TiffIfdEntry::DT_Float:
-            return 4;
-
-        case TiffIfdEntry::DT_Rational:
-        case TiffIfdEntry::DT_SRational:
-        case TiffIfdEntry::DT_Long8:
-        case TiffIfdEntry::DT_SLong8:
-        case TiffIfdEntry::DT_Ifd8:
-        case TiffIfdEntry::DT_Double:
-            return 8;
-        default:
-            return 0;
+        if constexpr (BigTiff)
+            return get<quint64>(bytes);
+        else
+            return get<quint16>(bytes);
+    }
+
+    // number of values of an entry
+    static quint64 valueCount(const char *bytes)
+    {
+        if constexpr (BigTiff)
+            return get<quint64>(bytes);
+        else
+            return get<quint32>(bytes);
+    }
+
+    static qint64 offset(const char *bytes)
+    {
+        if constexpr (BigTiff)
+            return get<qint64>(bytes);
+        else
+            return get<quint32>(bytes);
+    }
+};
+
+enum TiffPhase { HeaderPhase, DirectoryPhase, ValueDecodePhase, TiffPhaseCount };
+
+/*
+ * Counters behind TiffFile::stats(), they are updated from all the parser threads.
+ */
+struct TiffParserCounters
+{
+    QAtomicInteger<qint64> bytesRead;
+    QAtomicInteger<qint64> readCalls;
+    QAtomicInteger<qint64> seeks;
+    QAtomicInteger<qint64> ifds;
+    QAtomicInteger<qint64> entries;
+    QAtomicInteger<qint64> valueFetches;
+    QAtomicInteger<qint64> valueMemory;
+    QAtomicInteger<qint64> peakValueMemory;
+    // wall time of each phase on the calling threads, and time of all the threads
+    QAtomicInteger<qint64> phaseNsecs[TiffPhaseCount];
+    QAtomicInteger<qint64> phaseCpuNsecs[TiffPhaseCount];
+
+    void addValueMemory(qint64 bytes)
+    {
+        const qint64 memory = valueMemory.fetchAndAddRelaxed(bytes) + bytes;
+        qint64 peak = peakValueMemory.loadRelaxed();
+        while (memory > peak && !peakValueMemory.testAndSetRelaxed(peak, memory))
+            peak = peakValueMemory.loadRelaxed();
+    }
+};
+
+/*
+ * Adds the time spent in a scope to the counters of a phase. A timer started in
+ * the scope of another one on the same thread pauses it, so the time of nested
+ * phases isn't counted twice.
+ *
+ * The wall time is measured by the thread calling TiffFile, worker threads only add
+ * their time to the cpu time, as do the phases nested in their scope.
+ */
+class TiffPhaseTimer
+{
+public:
+    enum Mode { WallAndCpuTime, CpuTimeOnly, WallTimeOnly };
+
+    TiffPhaseTimer(TiffParserCounters *counters, TiffPhase phase, Mode mode = WallAndCpuTime)
+        : m_parent(t_current)
+    {
+        if (m_parent) {
+            m_parent->m_nsecs += m_parent->m_timer.nsecsElapsed();
+            if (!m_parent->m_wallNsecs)
+                mode = CpuTimeOnly;
         }
+        if (mode != CpuTimeOnly)
+            m_wallNsecs = &counters->phaseNsecs[phase];
+        if (mode != WallTimeOnly)
+            m_cpuNsecs = &counters->phaseCpuNsecs[phase];
+        t_current = this;
+        m_timer.start();
+    }
+    ~TiffPhaseTimer()
+    {
+        m_nsecs += m_timer.nsecsElapsed();
+        if (m_wallNsecs)
+            m_wallNsecs->fetchAndAddRelaxed(m_nsecs);
+        if (m_cpuNsecs)
+            m_cpuNsecs->fetchAndAddRelaxed(m_nsecs);
+        t_current = m_parent;
+        if (m_parent)
+            m_parent->m_timer.restart();
+    }
+
+private:
+    static thread_local TiffPhaseTimer *t_current;
+
+    TiffPhaseTimer *m_parent;
+    QAtomicInteger<qint64> *m_wallNsecs{ nullptr };
+    QAtomicInteger<qint64> *m_cpuNsecs{ nullptr };
+    qint64 m_nsecs{ 0 };
+    QElapsedTimer m_timer;
+};
+
+thread_local TiffPhaseTimer *TiffPhaseTimer::t_current = nullptr;
+
+/*
+ * The whole file in memory, either mapped or given to TiffFile::fromData(). Ifds
+ * which use values in place keep the mapping they point into, so that mapping a
+ * growing file again doesn't unmap the bytes of the value spans handed out before.
+ * The file is unmapped once the last of them is released.
+ */
+class TiffMapping : public QSharedData
+{
+public:
+    explicit TiffMapping(const QByteArray &bytes)
+        : data(bytes.constData())
+        , size(bytes.size())
+        , bytes(bytes)
+    {
+    }
+    TiffMapping(QFileDevice *fileDevice, uchar *mapped, qint64 size, QMutex *mutex)
+        : data(reinterpret_cast<const char *>(mapped))
+        , size(size)
+        , fileDevice(fileDevice)
+        , mutex(mutex)
+    {
+    }
+    ~TiffMapping()
+    {
+        if (!fileDevice)
+            return;
+        QMutexLocker locker(mutex);
+        fileDevice->unmap(reinterpret_cast<uchar *>(const_cast<char *>(data)));
+    }
+
+    const char *data{ nullptr };
+    qint64 size{ 0 };
+
+private:
+    QByteArray bytes; // keeps the buffer given to TiffFile::fromData() alive
+    QPointer<QFileDevice> fileDevice; // set when the file is mapped
+    QMutex *mutex{ nullptr }; // of the data source, which outlives its mappings
+};
+
+/*
+ * Random access to the bytes of a tiff file. It is shared by TiffFile and all the
+ * ifds, so that values can still be loaded on demand after parsing.
+ */
+class TiffDataSource : public QSharedData
+{
+public:
+    TiffDataSource() {}
+    ~TiffDataSource() {}
+
+    bool open(const QString &filePath, const TiffParserOptions &options);
+    bool open(QIODevice *ioDevice, const TiffParserOptions &options);
+    void open(const QByteArray &bytes);
+    void remap();
+    qint64 size();
+    enum ReadKind { IfdRead, ValueRead };
+    qint64 bytesAvailable(qint64 offset, ReadKind kind);
+    // whole file when it's in memory, or nullptr
+    const char *constData() const { return mapping ? mapping->data : nullptr; }
+    QExplicitlySharedDataPointer<TiffMapping> currentMapping() const { return mapping; }
+    QByteArray read(qint64 offset, qint64 maxSize);
+    QByteArray readRaw(qint64 offset, qint64 maxSize);
+    QString errorString() const { return error; }
+
+    TiffParserCounters counters;
+
+private:
+    QMutex mutex;
+    QFile file;
+    QPointer<QIODevice> device; // file, or the device given to TiffFile
+    std::unique_ptr<TiffStreamBuffer> stream; // sequential devices only
+    qint64 maxStreamIfdSize{ 0 };
+    qint64 maxStreamValueSize{ 0 };
+    // whole file, when it's mapped or in memory, it's released before the file
+    QExplicitlySharedDataPointer<TiffMapping> mapping;
+    QString error;
+};
+
+bool TiffDataSource::open(const QString &filePath, const TiffParserOptions &options)
+{
+    file.setFileName(filePath);
+    return open(&file, options);
+}
+
+bool TiffDataSource::open(QIODevice *ioDevice, const TiffParserOptions &options)
+{
+    if (!ioDevice) {
+        error = QStringLiteral("No device to read");
+        return false;
+    }
+    if (!ioDevice->isOpen() && !ioDevice->open(QIODevice::ReadOnly)) {
+        error = ioDevice->errorString();
+        return false;
+    }
+    if (!ioDevice->isReadable()) {
+        error = QStringLiteral("Device is not readable");
+        return false;
+    }
+    device = ioDevice;
+
+    if (device->isSequential()) {
+        stream.reset(new TiffStreamBuffer(ioDevice, options));
+        maxStreamIfdSize = qMax<qint64>(options.maxStreamIfdSize, 0);
+        maxStreamValueSize = qMax<qint64>(options.maxStreamValueSize, 0);
+        return true;
+    }
+
+    auto fileDevice = qobject_cast<QFileDevice *>(ioDevice);
+    if (options.useMemoryMap && fileDevice && fileDevice->size() > 0) {
+        const auto size = fileDevice->size();
+        if (auto mapped = fileDevice->map(0, size))
+            mapping.reset(new TiffMapping(fileDevice, mapped, size, &mutex));
+        else
+            qCDebug(tiffLog) << "Fail to map file, fall back to buffered reading:"
+                             << fileDevice->errorString();
+    }
+    return true;
+}
+
+/*
+ * Reads the file from \a bytes, which are shared rather than copied.
+ */
+void TiffDataSource::open(const QByteArray &bytes)
+{
+    mapping.reset(new TiffMapping(bytes));
+}
+
+/*
+ * Maps the file again if it has grown since it was mapped. The old mapping is
+ * unmapped once the ifds which use values in place from it are released, so the
+ * value spans handed out before stay valid.
+ */
+void TiffDataSource::remap()
+{
+    auto fileDevice = qobject_cast<QFileDevice *>(device.data());
+    if (!mapping || !fileDevice)
+        return;
+    QExplicitlySharedDataPointer<TiffMapping> oldMapping;
+    {
+        QMutexLocker locker(&mutex);
+        const auto size = fileDevice->size();
+        if (size <= mapping->size)
+            return;
+        auto mapped = fileDevice->map(0, size);
+        if (!mapped)
+            return;
+        // the old mapping is released after the lock, as it unmaps with it
+        oldMapping = mapping;
+        mapping.reset(new TiffMapping(fileDevice, mapped, size, &mutex));
     }
+}
 
-    void parserValues(const char *bytes, TiffFile::ByteOrder byteOrder);
+/*
+ * Size of the file, which is the largest offset for streams until they are
+ * read to the end.
+ */
+qint64 TiffDataSource::size()
+{
+    if (mapping)
+        return mapping->size;
+    QMutexLocker locker(&mutex);
+    if (stream)
+        return stream->size();
+    return device ? device->size() : 0;
+}
+
+/*
+ * Number of bytes from \a offset to the end of the file, which is used to reject
+ * corrupt counts before reading. While the size of a stream isn't known, this is
+ * at most TiffParserOptions::maxStreamIfdSize or maxStreamValueSize, following
+ * \a kind, so that a corrupt count can't make the whole stream be buffered.
+ */
+qint64 TiffDataSource::bytesAvailable(qint64 offset, ReadKind kind)
+{
+    const qint64 fileSize = size();
+    if (offset < 0 || offset >= fileSize)
+        return 0;
+
+    if (!mapping) {
+        QMutexLocker locker(&mutex);
+        if (stream && !stream->atEnd())
+            return qMin(fileSize - offset, kind == IfdRead ? maxStreamIfdSize : maxStreamValueSize);
+    }
+    return fileSize - offset;
+}
+
+/*
+ * Returns a copy of the bytes, which can be kept after the file is closed.
+ */
+QByteArray TiffDataSource::read(qint64 offset, qint64 maxSize)
+{
+    auto bytes = readRaw(offset, maxSize);
+    if (mapping)
+        return QByteArray(bytes.constData(), bytes.size());
+    return bytes;
+}
+
+/*
+ * Same as read(), but the mapped bytes are not copied when the file is mapped,
+ * so the result is only valid as long as this data source is alive.
+ */
+QByteArray TiffDataSource::readRaw(qint64 offset, qint64 maxSize)
+{
+    counters.readCalls.fetchAndAddRelaxed(1);
+    if (mapping) {
+        if (offset < 0 || offset > mapping->size)
+            return QByteArray();
+        const auto bytesCount = qBound<qint64>(0, maxSize, mapping->size - offset);
+        counters.bytesRead.fetchAndAddRelaxed(bytesCount);
+        return QByteArray::fromRawData(mapping->data + offset, static_cast<qsizetype>(bytesCount));
+    }
+
+    QMutexLocker locker(&mutex);
+    if (!device) {
+        qCDebug(tiffLog) << "Device is not open or has been deleted";
+        return QByteArray();
+    }
+    QByteArray bytes;
+    if (stream) {
+        bytes = stream->read(offset, maxSize);
+    } else {
+        if (device->pos() != offset) {
+            counters.seeks.fetchAndAddRelaxed(1);
+            if (!device->seek(offset)) {
+                qCDebug(tiffLog) << "Fail to seek pos: " << offset;
+                return QByteArray();
+            }
+        }
+        bytes = device->read(maxSize);
+    }
+    counters.bytesRead.fetchAndAddRelaxed(bytes.size());
+    return bytes;
+}
 
-    quint16 tag;
-    quint16 type;
+/*
+ * One ifd entry, as it's stored in TiffIfdPrivate::entries.
+ */
+struct TiffIfdEntryRecord
+{
+    enum ValueBlockIndex {
+        NoValueBlock = -1,
+        ValuesInSource = -2, // values are used in place, from TiffIfdPrivate::mapping
+    };
+
+    quint16 tag{ 0 };
+    quint16 type{ 0 };
+    bool valuesLoaded{ false };
+    int valueBlock{ NoValueBlock }; // index in TiffIfdPrivate::valueBlocks
     quint64 count{ 0 };
-    QByteArray valueOrOffset; // 12 bytes for tiff or 20 bytes for bigTiff
-    QVariantList values;
+    qint64 valueOffset{ -1 }; // -1 when the values are stored in valueOrOffset
+    qint64 valueIndex{ 0 }; // index of the first value in its value block
+    char valueOrOffset[8]{}; // 4 bytes for tiff or 8 bytes for bigTiff
+    quint64 inlineValues{ 0 }; // values of valueOrOffset in native byte order
+};
+
+static const TiffIfdEntryRecord g_invalidEntryRecord;
+
+/*
+ * The entries of an ifd are stored in one array of plain records, and TiffIfdEntry
+ * is a view of one of them, so parsing an ifd allocates the same memory whatever
+ * the number of entries, and it's freed at once with the ifd.
+ *
+ * Values are only read and decoded when they are accessed the first time.
+ * Inline values are decoded in their record, the others are decoded into value
+ * blocks, which are not moved once allocated so that spans of them stay valid.
+ * prefetchValues() decodes all the values of an ifd into one block. When the file
+ * is in memory, values which don't need to be decoded are used in place instead.
+ * Loading values is not thread safe.
+ */
+class TiffIfdPrivate : public QSharedData
+{
+public:
+    TiffIfdPrivate() {}
+    TiffIfdPrivate(const TiffIfdPrivate &other)
+        : QSharedData(other)
+        , entries(other.entries)
+        , subIfds(other.subIfds)
+        , nextIfdOffset(other.nextIfdOffset)
+        , byteOrder(other.byteOrder)
+        , offsetSize(other.offsetSize)
+        , source(other.source)
+        , mapping(other.mapping)
+        , valueBlocks(other.valueBlocks)
+    {
+        if (source)
+            source->counters.addValueMemory(valueMemory());
+    }
+    ~TiffIfdPrivate()
+    {
+        if (source)
+            source->counters.addValueMemory(-valueMemory());
+    }
+
+    bool hasIfdEntry(quint16 tag);
+    TiffIfdEntry ifdEntry(quint16 tag);
+
+    qint64 valueMemory() const;
+    int typeSize(int index) const { return dataTypeSize(entries[index].type); }
+    static int dataTypeSize(quint16 type);
+    qint64 valueBytesCount(int index) const { return entries[index].count * typeSize(index); }
+    qint64 valueBlockSize(int index) const { return (valueBytesCount(index) + 7) / 8; }
+
+    int appendValueBlock(qint64 size);
+    bool referenceValues(int index);
+    void loadValues(int index);
+    void setValueBytes(int index, const char *bytes, int block, qint64 valueIndex);
+    void parserValues(int index, const char *bytes, quint64 *dest);
+    template <TiffFile::ByteOrder Order>
+    void parserValues(int index, const char *bytes, quint64 *dest);
+    const char *valueBytes(int index);
+    quint64 unsignedValue(int index, qsizetype valueIndex);
+
+    template <typename T>
+    TiffValueSpan<T> valueSpan(int index, bool typeMatched)
+    {
+        auto bytes = valueBytes(index);
+        if (!typeMatched || !bytes)
+            return TiffValueSpan<T>();
+        return TiffValueSpan<T>(reinterpret_cast<const T *>(bytes), entries[index].count);
+    }
+
+    QVector<TiffIfdEntryRecord> entries;
+    QVector<TiffIfd> subIfds;
+    qint64 nextIfdOffset{ 0 };
+    TiffFile::ByteOrder byteOrder{ TiffFile::LittleEndian };
+    int offsetSize{ 4 };
+
+    QExplicitlySharedDataPointer<TiffDataSource> source;
+    // The file in memory which the values used in place point into. It's the one of
+    // the source when the first of them was loaded, and it's kept as long as the ifd.
+    QExplicitlySharedDataPointer<TiffMapping> mapping;
+    // Out of line values in native byte order, stored as arrays of the declared type.
+    // quint64 is used as the element type to keep all the types aligned.
+    QVector<QVector<quint64>> valueBlocks;
 };
 
-void TiffIfdEntryPrivate::parserValues(const char *bytes, TiffFile::ByteOrder byteOrder)
+bool TiffIfdPrivate::hasIfdEntry(quint16 tag)
+{
+    return ifdEntry(tag).isValid();
+}
+
+TiffIfdEntry TiffIfdPrivate::ifdEntry(quint16 tag)
+{
+    auto it = std::find_if(entries.cbegin(), entries.cend(),
+                           [tag](const TiffIfdEntryRecord &de) { return tag == de.tag; });
+    if (it == entries.cend())
+        return TiffIfdEntry();
+    return TiffIfdEntry(this, it - entries.cbegin());
+}
+
+qint64 TiffIfdPrivate::valueMemory() const
+{
+    qint64 memory = 0;
+    for (const auto &block : valueBlocks)
+        memory += block.size() * sizeof(quint64);
+    return memory;
+}
+
+int TiffIfdPrivate::dataTypeSize(quint16 type)
+{
+    switch (type) {
+    case TiffIfdEntry::DT_Byte:
+    case TiffIfdEntry::DT_SByte:
+    case TiffIfdEntry::DT_Ascii:
+    case TiffIfdEntry::DT_Undefined:
+        return 1;
+    case TiffIfdEntry::DT_Short:
+    case TiffIfdEntry::DT_SShort:
+        return 2;
+    case TiffIfdEntry::DT_Long:
+    case TiffIfdEntry::DT_SLong:
+    case TiffIfdEntry::DT_Ifd:
+    case TiffIfdEntry::DT_Float:
+        return 4;
+
+    case TiffIfdEntry::DT_Rational:
+    case TiffIfdEntry::DT_SRational:
+    case TiffIfdEntry::DT_Long8:
+    case TiffIfdEntry::DT_SLong8:
+    case TiffIfdEntry::DT_Ifd8:
+    case TiffIfdEntry::DT_Double:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Allocates a block of \a size values and returns its index.
+ */
+int TiffIfdPrivate::appendValueBlock(qint64 size)
+{
+    valueBlocks.append(QVector<quint64>(size));
+    if (source)
+        source->counters.addValueMemory(size * sizeof(quint64));
+    return valueBlocks.size() - 1;
+}
+
+/*
+ * Uses the values of the entry at \a index in place when the file is in memory,
+ * and they are single bytes, or in native byte order and aligned.
+ */
+bool TiffIfdPrivate::referenceValues(int index)
+{
+    auto &de = entries[index];
+    if (!source || de.valueOffset < 0)
+        return false;
+    if (!mapping)
+        mapping = source->currentMapping();
+    // values written after the file was mapped are only in a newer mapping
+    if (!mapping || de.valueOffset + valueBytesCount(index) > mapping->size)
+        return false;
+    const char *data = mapping->data;
+
+    int unitSize = typeSize(index);
+    if (de.type == TiffIfdEntry::DT_Rational || de.type == TiffIfdEntry::DT_SRational)
+        unitSize = 4;
+    const auto nativeByteOrder =
+        Q_BYTE_ORDER == Q_LITTLE_ENDIAN ? TiffFile::LittleEndian : TiffFile::BigEndian;
+    if (unitSize > 1
+        && (byteOrder != nativeByteOrder
+            || reinterpret_cast<quintptr>(data + de.valueOffset) % unitSize != 0))
+        return false;
+
+    de.valuesLoaded = true;
+    de.valueBlock = TiffIfdEntryRecord::ValuesInSource;
+    return true;
+}
+
+void TiffIfdPrivate::loadValues(int index)
 {
-    if (type == TiffIfdEntry::DT_Ascii) {
-        int start = 0;
-        for (int i = 0; i < count; ++i) {
+    auto &de = entries[index];
+    TIFF_TRACE_SPAN("loadValues", "tag", de.tag);
+    de.valuesLoaded = true;
+
+    // skip unknown datatype
+    if (de.count == 0 || typeSize(index) == 0)
+        return;
+
+    if (de.valueOffset == -1) {
+        parserValues(index, de.valueOrOffset, &de.inlineValues);
+        return;
+    }
+    if (!source)
+        return;
+
+    const qint64 bytesAvailable = source->bytesAvailable(de.valueOffset, TiffDataSource::ValueRead);
+    if (de.count > static_cast<quint64>(bytesAvailable / typeSize(index))) {
+        qCDebug(tiffLog) << "Values of tag" << de.tag << "are out of the file";
+        return;
+    }
+    if (referenceValues(index))
+        return;
+
+    TiffPhaseTimer timer(&source->counters, ValueDecodePhase);
+    source->counters.valueFetches.fetchAndAddRelaxed(1);
+    auto valueBytes = source->readRaw(de.valueOffset, valueBytesCount(index));
+    if (valueBytes.size() < valueBytesCount(index)) {
+        qCDebug(tiffLog) << "Fail to read values of tag" << de.tag;
+        return;
+    }
+    setValueBytes(index, valueBytes, appendValueBlock(valueBlockSize(index)), 0);
+}
+
+/*
+ * Decodes the out of line values of the entry at \a index from \a bytes, which hold
+ * valueBytesCount() bytes in file byte order, into \a block from \a valueIndex.
+ */
+void TiffIfdPrivate::setValueBytes(int index, const char *bytes, int block, qint64 valueIndex)
+{
+    auto &de = entries[index];
+    de.valuesLoaded = true;
+    de.valueBlock = block;
+    de.valueIndex = valueIndex;
+    parserValues(index, bytes, valueBlocks[block].data() + valueIndex);
+}
+
+void TiffIfdPrivate::parserValues(int index, const char *bytes, quint64 *dest)
+{
+    if (byteOrder == TiffFile::LittleEndian)
+        parserValues<TiffFile::LittleEndian>(index, bytes, dest);
+    else
+        parserValues<TiffFile::BigEndian>(index, bytes, dest);
+}
+
+template <TiffFile::ByteOrder Order>
+void TiffIfdPrivate::parserValues(int index, const char *bytes, quint64 *dest)
+{
+    const auto &de = entries[index];
+    const qint64 bytesCount = valueBytesCount(index);
+
+    // Rational values are pairs of 32bit integers.
+    int unitSize = typeSize(index);
+    if (de.type == TiffIfdEntry::DT_Rational || de.type == TiffIfdEntry::DT_SRational)
+        unitSize = 4;
+
+    switch (unitSize) {
+    case 2:
+        getValuesFromBytes<Order, quint16>(bytes, bytesCount / 2, dest);
+        break;
+    case 4:
+        getValuesFromBytes<Order, quint32>(bytes, bytesCount / 4, dest);
+        break;
+    case 8:
+        getValuesFromBytes<Order, quint64>(bytes, bytesCount / 8, dest);
+        break;
+    default:
+        memcpy(dest, bytes, bytesCount);
+        break;
+    }
+}
+
+/*
+ * Returns the values in native byte order, or nullptr if they can not be loaded.
+ */
+const char *TiffIfdPrivate::valueBytes(int index)
+{
+    if (!entries[index].valuesLoaded)
+        loadValues(index);
+
+    const auto &de = entries[index];
+    if (de.count == 0 || typeSize(index) == 0)
+        return nullptr;
+    if (de.valueOffset == -1)
+        return reinterpret_cast<const char *>(&de.inlineValues);
+    if (de.valueBlock == TiffIfdEntryRecord::ValuesInSource)
+        return mapping->data + de.valueOffset;
+    if (de.valueBlock == TiffIfdEntryRecord::NoValueBlock)
+        return nullptr;
+    return reinterpret_cast<const char *>(valueBlocks[de.valueBlock].constData() + de.valueIndex);
+}
+
+quint64 TiffIfdPrivate::unsignedValue(int index, qsizetype valueIndex)
+{
+    auto bytes = valueBytes(index);
+    const auto &de = entries[index];
+    if (!bytes || valueIndex < 0 || static_cast<quint64>(valueIndex) >= de.count)
+        return 0;
+
+    switch (de.type) {
+    case TiffIfdEntry::DT_Byte:
+        return reinterpret_cast<const quint8 *>(bytes)[valueIndex];
+    case TiffIfdEntry::DT_Short:
+        return reinterpret_cast<const quint16 *>(bytes)[valueIndex];
+    case TiffIfdEntry::DT_Long:
+    case TiffIfdEntry::DT_Ifd:
+        return reinterpret_cast<const quint32 *>(bytes)[valueIndex];
+    case TiffIfdEntry::DT_Long8:
+    case TiffIfdEntry::DT_Ifd8:
+        return reinterpret_cast<const quint64 *>(bytes)[valueIndex];
+    default:
+        return 0;
+    }
+}
+
+/*!
+ * \class TiffIfdEntry
+ */
+
+TiffIfdEntry::TiffIfdEntry() {}
+
+TiffIfdEntry::TiffIfdEntry(const TiffIfdEntry &other)
+    : d(other.d)
+    , m_index(other.m_index)
+{
+}
+
+TiffIfdEntry::TiffIfdEntry(TiffIfdPrivate *ifd, int index)
+    : d(ifd)
+    , m_index(index)
+{
+}
+
+TiffIfdEntry::~TiffIfdEntry()
+{
+}
+
+const TiffIfdEntryRecord &TiffIfdEntry::record() const
+{
+    return d ? d->entries[m_index] : g_invalidEntryRecord;
+}
+
+const char *TiffIfdEntry::valueBytes() const
+{
+    return d ? d->valueBytes(m_index) : nullptr;
+}
+
+template <typename T>
+TiffValueSpan<T> TiffIfdEntry::valueSpan(bool typeMatched) const
+{
+    return d ? d->valueSpan<T>(m_index, typeMatched) : TiffValueSpan<T>();
+}
+
+quint16 TiffIfdEntry::tag() const
+{
+    return record().tag;
+}
+
+QString TiffIfdEntry::tagName() const
+{
+    auto name = tagName(record().tag);
+    if (!name.isEmpty())
+        return name;
+
+    return QStringLiteral("UNKNOWNTAG(%1)").arg(record().tag);
+}
+
+/*!
+ * Returns the name of \a tag, or an empty string for unknown tags.
+ * No memory is allocated.
+ */
+QLatin1String TiffIfdEntry::tagName(quint16 tag)
+{
+    return g_tagNameTable.name(tag);
+}
+
+/*!
+ * Returns the other name of \a tag if it has two names, such as GROUP3OPTIONS
+ * for T4OPTIONS, or an empty string.
+ */
+QLatin1String TiffIfdEntry::tagAlias(quint16 tag)
+{
+    return g_tagNameTable.alias(tag);
+}
+
+/*!
+ * Returns the name of a Compression value, or an empty string if it is unknown.
+ */
+QLatin1String TiffIfdEntry::compressionName(quint16 compression)
+{
+    return g_compressionNameTable.name(compression);
+}
+
+quint16 TiffIfdEntry::type() const
+{
+    return record().type;
+}
+
+QString TiffIfdEntry::typeName() const
+{
+    return typeName(record().type);
+}
+
+QLatin1String TiffIfdEntry::typeName(quint16 type)
+{
+    if (type > 0 && type <= TiffIfdEntry::DT_Ifd8)
+        return g_dataTypeNames[type];
+
+    return QLatin1String();
+}
+
+quint64 TiffIfdEntry::count() const
+{
+    return record().count;
+}
+
+/*!
+ * Returns the number of values which can be accessed. It's count(), unless the
+ * data type is unknown or the values can not be read from the file.
+ */
+qsizetype TiffIfdEntry::valueCount() const
+{
+    return valueBytes() ? record().count : 0;
+}
+
+QByteArray TiffIfdEntry::valueOrOffset() const
+{
+    if (!d)
+        return QByteArray();
+    return QByteArray(record().valueOrOffset, d->offsetSize);
+}
+
+/*!
+ * Returns the values as a variant list, which is built each time this is called.
+ *
+ * Normal integer values are saved as qint32 or quint32, RATIONAL and SRATIONAL values
+ * take two items each, ASCII values are split into strings and UNDEFINED values are
+ * returned as one QByteArray. Prefer the typed span accessors for large arrays.
+ */
+QVariantList TiffIfdEntry::values() const
+{
+    QVariantList values;
+    auto bytes = valueBytes();
+    if (!bytes)
+        return values;
+    const qint64 count = record().count;
+    const auto type = record().type;
+
+    if (type == DT_Ascii) {
+        qint64 start = 0;
+        for (qint64 i = 0; i < count; ++i) {
             if (bytes[i] == '\0') {
                 values.append(QString::fromLatin1(bytes + start, i - start + 1));
                 start = i + 1;
@@ -366,262 +1254,596 @@ void TiffIfdEntryPrivate::parserValues(const char *bytes, TiffFile::ByteOrder by
             qCDebug(tiffLog) << "ASCII value donesn't end with NUL";
             values.append(QString::fromLatin1(bytes + start, count - start));
         }
-        return;
+        return values;
     }
 
-    if (type == TiffIfdEntry::DT_Undefined) {
+    if (type == DT_Undefined) {
         values.append(QByteArray(bytes, count));
-        return;
+        return values;
     }
 
-    // To make things simple, save normal integer as qint32 or quint32 here.
-    for (int i = 0; i < count; ++i) {
+    values.reserve(type == DT_Rational || type == DT_SRational ? count * 2 : count);
+    for (qint64 i = 0; i < count; ++i) {
         switch (type) {
-        case TiffIfdEntry::DT_Byte:
-            values.append(static_cast<quint32>(bytes[i]));
+        case DT_Byte:
+            values.append(static_cast<quint32>(reinterpret_cast<const quint8 *>(bytes)[i]));
             break;
-        case TiffIfdEntry::DT_SByte:
-            values.append(static_cast<qint32>(bytes[i]));
+        case DT_SByte:
+            values.append(static_cast<qint32>(reinterpret_cast<const qint8 *>(bytes)[i]));
             break;
-        case TiffIfdEntry::DT_Short:
-            values.append(
-                static_cast<quint32>(getValueFromBytes<quint16>(bytes + i * 2, byteOrder)));
+        case DT_Short:
+            values.append(static_cast<quint32>(reinterpret_cast<const quint16 *>(bytes)[i]));
             break;
-        case TiffIfdEntry::DT_SShort:
-            values.append(static_cast<qint32>(getValueFromBytes<qint16>(bytes + i * 2, byteOrder)));
+        case DT_SShort:
+            values.append(static_cast<qint32>(reinterpret_cast<const qint16 *>(bytes)[i]));
             break;
-        case TiffIfdEntry::DT_Long:
-        case TiffIfdEntry::DT_Ifd:
-            values.append(getValueFromBytes<quint32>(bytes + i * 4, byteOrder));
+        case DT_Long:
+        case DT_Ifd:
+            values.append(reinterpret_cast<const quint32 *>(bytes)[i]);
             break;
-        case TiffIfdEntry::DT_SLong:
-            values.append(getValueFromBytes<qint32>(bytes + i * 4, byteOrder));
+        case DT_SLong:
+            values.append(reinterpret_cast<const qint32 *>(bytes)[i]);
             break;
-        case TiffIfdEntry::DT_Float:
-            values.append(*(reinterpret_cast<const float *>(bytes + i * 4)));
+        case DT_Float:
+            values.append(reinterpret_cast<const float *>(bytes)[i]);
             break;
-        case TiffIfdEntry::DT_Double:
-            values.append(*(reinterpret_cast<const double *>(bytes + i * 8)));
+        case DT_Double:
+            values.append(reinterpret_cast<const double *>(bytes)[i]);
             break;
-        case TiffIfdEntry::DT_Rational:
-            values.append(getValueFromBytes<quint32>(bytes + i * 4, byteOrder));
-            values.append(getValueFromBytes<quint32>(bytes + i * 4 + 4, byteOrder));
+        case DT_Rational:
+            values.append(reinterpret_cast<const quint32 *>(bytes)[i * 2]);
+            values.append(reinterpret_cast<const quint32 *>(bytes)[i * 2 + 1]);
             break;
-        case TiffIfdEntry::DT_SRational:
-            values.append(getValueFromBytes<qint32>(bytes + i * 4, byteOrder));
-            values.append(getValueFromBytes<qint32>(bytes + i * 4 + 4, byteOrder));
+        case DT_SRational:
+            values.append(reinterpret_cast<const qint32 *>(bytes)[i * 2]);
+            values.append(reinterpret_cast<const qint32 *>(bytes)[i * 2 + 1]);
             break;
-        case TiffIfdEntry::DT_Long8:
-        case TiffIfdEntry::DT_Ifd8:
-            values.append(getValueFromBytes<quint64>(bytes + i * 8, byteOrder));
+        case DT_Long8:
+        case DT_Ifd8:
+            values.append(reinterpret_cast<const quint64 *>(bytes)[i]);
             break;
-        case TiffIfdEntry::DT_SLong8:
-            values.append(getValueFromBytes<qint64>(bytes + i * 8, byteOrder));
+        case DT_SLong8:
+            values.append(reinterpret_cast<const qint64 *>(bytes)[i]);
             break;
         default:
             break;
         }
     }
+    return values;
 }
 
 /*!
- * \class TiffIfdEntry
+ * Returns the values of BYTE, ASCII or UNDEFINED entries.
  */
-
-TiffIfdEntry::TiffIfdEntry()
-    : d(new TiffIfdEntryPrivate)
+TiffValueSpan<quint8> TiffIfdEntry::toUInt8Span() const
 {
+    const auto type = record().type;
+    return valueSpan<quint8>(type == DT_Byte || type == DT_Ascii || type == DT_Undefined);
 }
 
-TiffIfdEntry::TiffIfdEntry(const TiffIfdEntry &other)
-    : d(other.d)
+TiffValueSpan<qint8> TiffIfdEntry::toInt8Span() const
 {
+    return valueSpan<qint8>(record().type == DT_SByte);
 }
 
-TiffIfdEntry::~TiffIfdEntry()
+TiffValueSpan<quint16> TiffIfdEntry::toUInt16Span() const
 {
+    return valueSpan<quint16>(record().type == DT_Short);
 }
 
-quint16 TiffIfdEntry::tag() const
+TiffValueSpan<qint16> TiffIfdEntry::toInt16Span() const
 {
-    return d->tag;
+    return valueSpan<qint16>(record().type == DT_SShort);
 }
 
-QString TiffIfdEntry::tagName() const
+/*!
+ * Returns the values of LONG or IFD entries.
+ */
+TiffValueSpan<quint32> TiffIfdEntry::toUInt32Span() const
 {
-    if (g_tagNames.contains(d->tag))
-        return QString::fromLatin1(g_tagNames[d->tag]);
-
-    return QStringLiteral("UNKNOWNTAG(%1)").arg(d->tag);
+    return valueSpan<quint32>(record().type == DT_Long || record().type == DT_Ifd);
 }
 
-quint16 TiffIfdEntry::type() const
+TiffValueSpan<qint32> TiffIfdEntry::toInt32Span() const
 {
-    return d->type;
+    return valueSpan<qint32>(record().type == DT_SLong);
 }
 
-QString TiffIfdEntry::typeName() const
+/*!
+ * Returns the values of LONG8 or IFD8 entries.
+ */
+TiffValueSpan<quint64> TiffIfdEntry::toUInt64Span() const
 {
-    if (d->type > 0 && d->type < TiffIfdEntry::DT_Ifd8)
-        return g_dataTypeName[d->type];
+    return valueSpan<quint64>(record().type == DT_Long8 || record().type == DT_Ifd8);
+}
 
-    return QString();
+TiffValueSpan<qint64> TiffIfdEntry::toInt64Span() const
+{
+    return valueSpan<qint64>(record().type == DT_SLong8);
 }
 
-quint64 TiffIfdEntry::count() const
+TiffValueSpan<float> TiffIfdEntry::toFloatSpan() const
 {
-    return d->count;
+    return valueSpan<float>(record().type == DT_Float);
 }
 
-QByteArray TiffIfdEntry::valueOrOffset() const
+TiffValueSpan<double> TiffIfdEntry::toDoubleSpan() const
 {
-    return d->valueOrOffset;
+    return valueSpan<double>(record().type == DT_Double);
 }
 
-QVariantList TiffIfdEntry::values() const
+/*!
+ * Returns the value at \a index of RATIONAL or SRATIONAL entries.
+ */
+TiffRational TiffIfdEntry::rationalAt(qsizetype index) const
 {
-    return d->values;
+    TiffRational rational;
+    auto bytes = valueBytes();
+    if (!bytes || index < 0 || static_cast<quint64>(index) >= record().count)
+        return rational;
+
+    if (record().type == DT_Rational) {
+        rational.numerator = reinterpret_cast<const quint32 *>(bytes)[index * 2];
+        rational.denominator = reinterpret_cast<const quint32 *>(bytes)[index * 2 + 1];
+    } else if (record().type == DT_SRational) {
+        rational.numerator = reinterpret_cast<const qint32 *>(bytes)[index * 2];
+        rational.denominator = reinterpret_cast<const qint32 *>(bytes)[index * 2 + 1];
+    }
+    return rational;
 }
 
 QString TiffIfdEntry::valueDescription() const
 {
-    if (d->tag == T_Compression && d->values.size() == 1) {
-        const int v = d->values[0].toInt();
-
-        if (g_compressionNames.contains(v))
-            return QString::fromLatin1(g_compressionNames[v]);
+    if (record().tag == T_Compression && record().count == 1) {
+        const auto v = d->unsignedValue(m_index, 0);
+        if (v <= 0xffff)
+            return compressionName(v);
     }
     return QString();
 }
 
 bool TiffIfdEntry::isValid() const
 {
-    return d->count;
+    return record().count;
 }
 
-class TiffIfdPrivate : public QSharedData
+/*!
+ * \class TiffIfd
+ */
+
+TiffIfd::TiffIfd()
+    : d(new TiffIfdPrivate)
 {
-public:
-    TiffIfdPrivate() {}
-    TiffIfdPrivate(const TiffIfdPrivate &other)
-        : QSharedData(other)
-        , ifdEntries(other.ifdEntries)
-        , subIfds(other.subIfds)
-        , nextIfdOffset(other.nextIfdOffset)
-    {
-    }
-    ~TiffIfdPrivate() {}
+}
 
-    bool hasIfdEntry(quint16 tag);
-    TiffIfdEntry ifdEntry(quint16 tag);
+TiffIfd::TiffIfd(const TiffIfd &other)
+    : d(other.d)
+{
+}
 
+TiffIfd::~TiffIfd()
+{
+}
+
+/*!
+ * Returns views of all the entries. Prefer entryCount() and ifdEntry() to
+ * access them one by one, which doesn't build a vector.
+ */
+QVector<TiffIfdEntry> TiffIfd::ifdEntries() const
+{
     QVector<TiffIfdEntry> ifdEntries;
-    QVector<TiffIfd> subIfds;
-    qint64 nextIfdOffset{ 0 };
-};
+    ifdEntries.reserve(d->entries.size());
+    for (int i = 0; i < d->entries.size(); ++i)
+        ifdEntries.append(TiffIfdEntry(d.data(), i));
+    return ifdEntries;
+}
 
-bool TiffIfdPrivate::hasIfdEntry(quint16 tag)
+int TiffIfd::entryCount() const
 {
-    return ifdEntry(tag).isValid();
+    return d->entries.size();
 }
 
-TiffIfdEntry TiffIfdPrivate::ifdEntry(quint16 tag)
+TiffIfdEntry TiffIfd::ifdEntry(int index) const
 {
-    auto it = std::find_if(ifdEntries.cbegin(), ifdEntries.cend(),
-                           [tag](const TiffIfdEntry &de) { return tag == de.tag(); });
-    if (it == ifdEntries.cend())
+    if (index < 0 || index >= d->entries.size())
         return TiffIfdEntry();
-    return *it;
+    return TiffIfdEntry(d.data(), index);
 }
 
-/*!
- * \class TiffIfd
+QVector<TiffIfd> TiffIfd::subIfds() const
+{
+    return d->subIfds;
+}
+
+qint64 TiffIfd::nextIfdOffset() const
+{
+    return d->nextIfdOffset;
+}
+
+bool TiffIfd::isValid() const
+{
+    return !d->entries.isEmpty();
+}
+
+namespace {
+/*
+ * Threads which parse the ifds of all the files. They are kept as long as the
+ * process runs, so that parsing one file after the other doesn't start new threads,
+ * each of which would keep its own trace buffer.
  */
+class TiffParserThreadPool : public QThreadPool
+{
+public:
+    TiffParserThreadPool() { setExpiryTimeout(-1); }
+};
+} // namespace
 
-TiffIfd::TiffIfd()
-    : d(new TiffIfdPrivate)
+Q_GLOBAL_STATIC(TiffParserThreadPool, g_parserThreadPool)
+
+class TiffFilePrivate
 {
+public:
+    // Sub ifds read in one ifd tree, out of the ones which are still available.
+    struct SubIfdBudget
+    {
+        int available{ 0 };
+        int used{ 0 };
+        // smallest budget which reads the tree the same way, it's more than available
+        // when sub ifds have been left out
+        qint64 needed{ 0 };
+    };
+
+    TiffFilePrivate();
+    TiffFilePrivate(const TiffFilePrivate &other);
+    static TiffIfd copyIfd(const TiffIfd &ifd);
+    void setError(const QString &errorString, qint64 incompleteIfdOffset = -1);
+    void parse();
+    QByteArray cacheData();
+    void writeCacheIfd(QDataStream &out, const TiffIfd &ifd);
+    bool restoreCache(const QByteArray &data);
+    bool readCacheIfd(QDataStream &in, TiffIfd *ifd, int depth);
+    bool readHeader();
+    void selectLayout();
+    template <typename Layout>
+    void useLayout();
+    bool scanIfdOffsets(qint64 count = std::numeric_limits<qint64>::max());
+    TiffIfd readIfdTree(qint64 offset, SubIfdBudget *budget);
+    void readSubIfds(const TiffIfd &ifd, qint64 offset, SubIfdBudget *budget);
+    void uncountSubIfds(const TiffIfd &ifd);
+    void prefetchValues(const TiffIfd &ifd);
+    bool readIfd(qint64 offset, TiffIfd *ifd) { return (this->*readIfdFunc)(offset, ifd); }
+    TiffIfd ifd(int index);
+    void parseIfds();
+    void parseIfds(int first, int end);
+    int refresh();
+
+    template <typename Layout>
+    void scanIfdOffsets(qint64 count);
+    template <typename Layout>
+    void rescanIfdOffsets();
+    template <typename Layout>
+    void scanIfdChain(qint64 count, bool rescan);
+    template <typename Layout>
+    bool readIfd(qint64 offset, TiffIfd *ifd);
+
+    struct Header
+    {
+        QByteArray rawBytes;
+        TiffFile::ByteOrder byteOrder{ TiffFile::LittleEndian };
+        quint16 version{ 42 };
+        qint64 ifd0Offset{ 0 };
+
+        bool isBigTiff() const { return version == 43; }
+    } header;
+
+    // offsets of IFD0, IFD1, ... found so far and the ifds parsed so far
+    QVector<qint64> ifdOffsets;
+    QSet<qint64> visitedIfdOffsets;
+    bool ifdOffsetsScanned{ false };
+    qint64 nextScanOffset{ 0 }; // next ifd of the chain to scan, 0 once the chain ends
+    QVector<TiffIfd> ifds;
+    QVector<bool> ifdsParsed;
+    // ifds which can still be read without exceeding maxIfds, the chain scan takes
+    // one per ifd it finds, and the ifd trees take their sub ifds when they are parsed
+    int ifdBudget{ 0 };
+
+    QExplicitlySharedDataPointer<TiffDataSource> source;
+    QString filePath; // empty unless the file is opened by path
+    // size and modification time of the file when it's opened, which key the cache
+    qint64 fileSize{ -1 };
+    QDateTime fileModified;
+    bool loadedFromCache{ false };
+    QMutex errorMutex;
+    QString errorString;
+    bool hasError{ false };
+    // offset of the incomplete ifd which ends the chain, when it's the only error
+    qint64 incompleteIfdOffset{ -1 };
+
+    TiffParserOptions parserOptions;
+
+    // instantiations for the byte order and the offset width of the file
+    void (TiffFilePrivate::*scanIfdOffsetsFunc)(qint64 count);
+    void (TiffFilePrivate::*rescanIfdOffsetsFunc)();
+    bool (TiffFilePrivate::*readIfdFunc)(qint64 offset, TiffIfd *ifd);
+};
+
+TiffFilePrivate::TiffFilePrivate()
+    : source(new TiffDataSource)
+{
+    selectLayout();
 }
 
-TiffIfd::TiffIfd(const TiffIfd &other)
-    : d(other.d)
+/*
+ * The ifds are copied, so the copy and \a other can be used in different threads.
+ * The source and the value blocks, which are not written once filled, are shared.
+ */
+TiffFilePrivate::TiffFilePrivate(const TiffFilePrivate &other)
+    : header(other.header)
+    , ifdOffsets(other.ifdOffsets)
+    , visitedIfdOffsets(other.visitedIfdOffsets)
+    , ifdOffsetsScanned(other.ifdOffsetsScanned)
+    , nextScanOffset(other.nextScanOffset)
+    , ifdsParsed(other.ifdsParsed)
+    , ifdBudget(other.ifdBudget)
+    , source(other.source)
+    , filePath(other.filePath)
+    , fileSize(other.fileSize)
+    , fileModified(other.fileModified)
+    , loadedFromCache(other.loadedFromCache)
+    , errorString(other.errorString)
+    , hasError(other.hasError)
+    , incompleteIfdOffset(other.incompleteIfdOffset)
+    , parserOptions(other.parserOptions)
 {
+    ifds.reserve(other.ifds.size());
+    for (const auto &ifd : other.ifds)
+        ifds.append(copyIfd(ifd));
+    selectLayout();
 }
 
-TiffIfd::~TiffIfd()
+TiffIfd TiffFilePrivate::copyIfd(const TiffIfd &ifd)
 {
+    TiffIfd copy;
+    copy.d.reset(new TiffIfdPrivate(*ifd.d));
+    // inline values are used in place from the records, the original ones must not
+    // be moved by a detach when values of the original ifd are loaded afterwards
+    copy.d->entries.detach();
+    copy.d->valueBlocks.detach();
+    for (auto &subIfd : copy.d->subIfds)
+        subIfd = copyIfd(subIfd);
+    return copy;
 }
 
-QVector<TiffIfdEntry> TiffIfd::ifdEntries() const
+/*
+ * Reads the header, and the ifds unless they are parsed on demand.
+ */
+void TiffFilePrivate::parse()
 {
-    return d->ifdEntries;
+    ifdBudget = parserOptions.maxIfds;
+    {
+        TiffPhaseTimer timer(&source->counters, HeaderPhase);
+        if (!readHeader())
+            return;
+    }
+
+    if (parserOptions.cache && !filePath.isEmpty()) {
+        const auto data =
+            parserOptions.cache->find(filePath, fileSize, fileModified, header.rawBytes);
+        if (!data.isEmpty() && restoreCache(data)) {
+            loadedFromCache = true;
+            return;
+        }
+    }
+
+    if (parserOptions.parseIfdsOnDemand)
+        return;
+
+    TiffPhaseTimer timer(&source->counters, DirectoryPhase);
+    parseIfds();
 }
 
-QVector<TiffIfd> TiffIfd::subIfds() const
+/*
+ * Writes the ifds for TiffParseCache, with the out of line values which have been
+ * decoded so far. Other values are read from the file when they are used, as
+ * they would be after parsing. Values are written in native byte order, so they
+ * are restored without being decoded again.
+ */
+QByteArray TiffFilePrivate::cacheData()
 {
-    return d->subIfds;
+    TIFF_TRACE_SPAN("cacheData");
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << CacheDataVersion << quint8(Q_BYTE_ORDER == Q_LITTLE_ENDIAN) << header.rawBytes
+        << quint8(parserOptions.parserSubIfds) << qint32(parserOptions.maxIfds)
+        << qint32(parserOptions.maxIfdDepth) << ifdOffsets;
+    for (const auto &ifd : std::as_const(ifds))
+        writeCacheIfd(out, ifd);
+    return data;
 }
 
-qint64 TiffIfd::nextIfdOffset() const
+void TiffFilePrivate::writeCacheIfd(QDataStream &out, const TiffIfd &ifd)
 {
-    return d->nextIfdOffset;
+    auto ifdPrivate = ifd.d.data();
+    const auto &entries = ifdPrivate->entries;
+    // values used in place from the file are not written either
+    auto outOfLineValues = [ifdPrivate](int index) -> const char * {
+        const auto &de = ifdPrivate->entries[index];
+        if (de.valueOffset < 0 || !de.valuesLoaded || de.valueBlock < 0)
+            return nullptr;
+        return reinterpret_cast<const char *>(ifdPrivate->valueBlocks[de.valueBlock].constData()
+                                              + de.valueIndex);
+    };
+
+    qint64 blockSize = 0;
+    for (int i = 0; i < entries.size(); ++i) {
+        if (outOfLineValues(i))
+            blockSize += ifdPrivate->valueBlockSize(i);
+    }
+    out << quint32(entries.size()) << blockSize;
+    for (int i = 0; i < entries.size(); ++i) {
+        const auto &de = entries[i];
+        out << de.tag << de.type << de.count << de.valueOffset;
+        out.writeRawData(de.valueOrOffset, sizeof(de.valueOrOffset));
+        const char *values = outOfLineValues(i);
+        out << quint8(values != nullptr);
+        if (values)
+            out.writeRawData(values, ifdPrivate->valueBytesCount(i));
+    }
+
+    out << ifdPrivate->nextIfdOffset << quint32(ifdPrivate->subIfds.size());
+    for (const auto &subIfd : std::as_const(ifdPrivate->subIfds))
+        writeCacheIfd(out, subIfd);
 }
 
-bool TiffIfd::isValid() const
+/*
+ * Restores the ifds written by cacheData(), returns false if the data doesn't
+ * match the file and the options.
+ */
+bool TiffFilePrivate::restoreCache(const QByteArray &data)
 {
-    return !d->ifdEntries.isEmpty();
+    TIFF_TRACE_SPAN("restoreCache");
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 version = 0;
+    quint8 littleEndian = 0;
+    QByteArray headerBytes;
+    quint8 subIfdsParsed = 0;
+    qint32 maxIfds = 0;
+    qint32 maxIfdDepth = 0;
+    QVector<qint64> offsets;
+    in >> version >> littleEndian >> headerBytes >> subIfdsParsed >> maxIfds >> maxIfdDepth
+        >> offsets;
+    if (in.status() != QDataStream::Ok || version != CacheDataVersion
+        || littleEndian != (Q_BYTE_ORDER == Q_LITTLE_ENDIAN) || headerBytes != header.rawBytes
+        || subIfdsParsed != parserOptions.parserSubIfds || maxIfds != parserOptions.maxIfds
+        || maxIfdDepth != parserOptions.maxIfdDepth)
+        return false;
+
+    // the restored ifds, sub ifds included, count against maxIfds as if they were parsed
+    ifdBudget = parserOptions.maxIfds;
+    QVector<TiffIfd> cachedIfds(offsets.size());
+    for (auto &ifd : cachedIfds) {
+        if (!readCacheIfd(in, &ifd, 0)) {
+            qCDebug(tiffLog) << "Invalid parse cache data";
+            return false;
+        }
+    }
+
+    ifdOffsets = offsets;
+    visitedIfdOffsets = QSet<qint64>(offsets.cbegin(), offsets.cend());
+    ifdOffsetsScanned = true;
+    ifds = cachedIfds;
+    ifdsParsed.fill(true, ifds.size());
+    return true;
 }
 
-class TiffFilePrivate
+bool TiffFilePrivate::readCacheIfd(QDataStream &in, TiffIfd *ifd, int depth)
 {
-public:
-    TiffFilePrivate();
-    void setError(const QString &errorString);
-    bool readHeader();
-    bool readIfd(qint64 offset, TiffIfd *parentIfd = nullptr);
+    if (depth > parserOptions.maxIfdDepth)
+        return false;
 
-    template <typename T>
-    T getValueFromFile()
-    {
-        T v{ 0 };
-        auto bytesRead = file.read(reinterpret_cast<char *>(&v), sizeof(T));
-        if (bytesRead != sizeof(T))
-            qCDebug(tiffLog) << "file read error.";
-        return fixValueByteOrder(v, header.byteOrder);
-    }
+    auto ifdPrivate = ifd->d.data();
+    ifdPrivate->byteOrder = header.byteOrder;
+    ifdPrivate->offsetSize = header.isBigTiff() ? 8 : 4;
+    ifdPrivate->source = source;
+
+    quint32 entryCount = 0;
+    qint64 blockSize = 0;
+    in >> entryCount >> blockSize;
+    const qint64 bytesAvailable = in.device()->bytesAvailable();
+    if (in.status() != QDataStream::Ok || entryCount > bytesAvailable || blockSize < 0
+        || blockSize > bytesAvailable)
+        return false;
 
-    struct Header
-    {
-        QByteArray rawBytes;
-        TiffFile::ByteOrder byteOrder{ TiffFile::LittleEndian };
-        quint16 version{ 42 };
-        qint64 ifd0Offset{ 0 };
+    ifdPrivate->entries.resize(entryCount);
+    const int block = blockSize ? ifdPrivate->appendValueBlock(blockSize) : -1;
+    qint64 valueIndex = 0;
+    for (int i = 0; i < ifdPrivate->entries.size(); ++i) {
+        auto &de = ifdPrivate->entries[i];
+        quint8 hasValues = 0;
+        in >> de.tag >> de.type >> de.count >> de.valueOffset;
+        in.readRawData(de.valueOrOffset, sizeof(de.valueOrOffset));
+        in >> hasValues;
+        // counts are checked before they are multiplied, so they can't overflow
+        const int typeSize = ifdPrivate->typeSize(i);
+        if (de.valueOffset < 0 && typeSize
+            && de.count > static_cast<quint64>(ifdPrivate->offsetSize / typeSize))
+            return false;
+        // values which aren't cached are loaded on demand from the file
+        if (!hasValues)
+            continue;
 
-        bool isBigTiff() const { return version == 43; }
-    } header;
+        if (de.valueOffset < 0 || block < 0 || !typeSize
+            || de.count > static_cast<quint64>((blockSize - valueIndex) * 8) / typeSize)
+            return false;
+        const qint64 size = ifdPrivate->valueBlockSize(i);
+        const qint64 bytesCount = ifdPrivate->valueBytesCount(i);
+        auto dest = reinterpret_cast<char *>(ifdPrivate->valueBlocks[block].data() + valueIndex);
+        if (in.readRawData(dest, bytesCount) != bytesCount)
+            return false;
+        de.valuesLoaded = true;
+        de.valueBlock = block;
+        de.valueIndex = valueIndex;
+        valueIndex += size;
+    }
 
-    QVector<TiffIfd> ifds;
+    quint32 subIfdCount = 0;
+    in >> ifdPrivate->nextIfdOffset >> subIfdCount;
+    if (in.status() != QDataStream::Ok || subIfdCount > in.device()->bytesAvailable())
+        return false;
+    for (quint32 i = 0; i < subIfdCount; ++i) {
+        TiffIfd subIfd;
+        if (!readCacheIfd(in, &subIfd, depth + 1))
+            return false;
+        ifdPrivate->subIfds.append(subIfd);
+    }
 
-    QFile file;
-    QString errorString;
-    bool hasError{ false };
+    --ifdBudget;
+    source->counters.ifds.fetchAndAddRelaxed(1);
+    source->counters.entries.fetchAndAddRelaxed(entryCount);
+    return in.status() == QDataStream::Ok;
+}
 
-    TiffParserOptions parserOptions;
-};
+/*
+ * Picks the directory parser instantiated for the flavour of the file.
+ */
+void TiffFilePrivate::selectLayout()
+{
+    if (header.byteOrder == TiffFile::LittleEndian) {
+        if (header.isBigTiff())
+            useLayout<TiffLayout<TiffFile::LittleEndian, true>>();
+        else
+            useLayout<TiffLayout<TiffFile::LittleEndian, false>>();
+    } else {
+        if (header.isBigTiff())
+            useLayout<TiffLayout<TiffFile::BigEndian, true>>();
+        else
+            useLayout<TiffLayout<TiffFile::BigEndian, false>>();
+    }
+}
 
-TiffFilePrivate::TiffFilePrivate()
+template <typename Layout>
+void TiffFilePrivate::useLayout()
 {
+    scanIfdOffsetsFunc = &TiffFilePrivate::scanIfdOffsets<Layout>;
+    rescanIfdOffsetsFunc = &TiffFilePrivate::rescanIfdOffsets<Layout>;
+    readIfdFunc = &TiffFilePrivate::readIfd<Layout>;
 }
 
-void TiffFilePrivate::setError(const QString &errorString)
+void TiffFilePrivate::setError(const QString &errorString, qint64 incompleteIfdOffset)
 {
+    QMutexLocker locker(&errorMutex);
+    // an incomplete ifd found after another error doesn't clear it when it's read
+    this->incompleteIfdOffset = hasError ? -1 : incompleteIfdOffset;
     hasError = true;
     this->errorString = errorString;
 }
 
 bool TiffFilePrivate::readHeader()
 {
-    auto headerBytes = file.peek(8);
+    TIFF_TRACE_SPAN("readHeader");
+    auto headerBytes = source->readRaw(0, 8);
     if (headerBytes.size() != 8) {
         setError(QStringLiteral("Invalid tiff file"));
         return false;
@@ -644,7 +1866,7 @@ bool TiffFilePrivate::readHeader()
         setError(QStringLiteral("Invalid tiff file: Unknown version"));
         return false;
     }
-    header.rawBytes = file.read(header.isBigTiff() ? 16 : 8);
+    header.rawBytes = source->read(0, header.isBigTiff() ? 16 : 8);
 
     // ifd0Offset
     if (!header.isBigTiff())
@@ -652,92 +1874,483 @@ bool TiffFilePrivate::readHeader()
             getValueFromBytes<quint32>(header.rawBytes.data() + 4, header.byteOrder);
     else
         header.ifd0Offset = getValueFromBytes<qint64>(header.rawBytes.data() + 8, header.byteOrder);
+    nextScanOffset = header.ifd0Offset;
 
+    selectLayout();
     return true;
 }
 
-bool TiffFilePrivate::readIfd(qint64 offset, TiffIfd *parentIfd)
+/*
+ * Collects the offsets of IFD0, IFD1, ... until \a count of them are known or the
+ * chain ends, the scan goes on from there the next time. Only the entry count and
+ * the next ifd offset of each ifd are read, the entry tables are skipped.
+ */
+bool TiffFilePrivate::scanIfdOffsets(qint64 count)
 {
-    if (!file.seek(offset)) {
-        setError(file.errorString());
-        return false;
+    if (ifdOffsetsScanned || ifdOffsets.size() >= count)
+        return !hasError;
+    TIFF_TRACE_SPAN("scanIfdOffsets");
+
+    (this->*scanIfdOffsetsFunc)(count);
+
+    ifds.resize(ifdOffsets.size());
+    ifdsParsed.resize(ifdOffsets.size());
+    return !hasError;
+}
+
+template <typename Layout>
+void TiffFilePrivate::scanIfdOffsets(qint64 count)
+{
+    scanIfdChain<Layout>(count, false);
+}
+
+/*
+ * Scans the chain again from the next ifd offset of the last known ifd, which is
+ * updated when an ifd is appended to the file.
+ */
+template <typename Layout>
+void TiffFilePrivate::rescanIfdOffsets()
+{
+    const int countSize = Layout::countSize;
+    const int offsetSize = Layout::offsetSize;
+
+    qint64 nextOffsetPos = offsetSize; // ifd0 offset in the header
+    if (!ifdOffsets.isEmpty()) {
+        const qint64 offset = ifdOffsets.last();
+        const auto countBytes = source->readRaw(offset, countSize);
+        if (countBytes.size() != countSize)
+            return;
+        nextOffsetPos = offset + countSize + Layout::entryCount(countBytes) * Layout::entrySize;
     }
+    const auto nextOffsetBytes = source->readRaw(nextOffsetPos, offsetSize);
+    if (nextOffsetBytes.size() != offsetSize)
+        return;
+    nextScanOffset = Layout::offset(nextOffsetBytes);
+    scanIfdChain<Layout>(std::numeric_limits<qint64>::max(), true);
+}
 
-    TiffIfd ifd;
+/*
+ * Appends the offsets of the ifds chained from nextScanOffset, until \a count of
+ * them are known. When the chain is rescanned, or when the file is growing, an
+ * incomplete ifd isn't an error, as the file may still be written, and it's read
+ * again by the next rescan.
+ */
+template <typename Layout>
+void TiffFilePrivate::scanIfdChain(qint64 count, bool rescan)
+{
+    const int countSize = Layout::countSize;
+    const int entrySize = Layout::entrySize;
+    const int offsetSize = Layout::offsetSize;
+
+    qint64 offset = nextScanOffset;
+    const bool tolerant = rescan || parserOptions.growingFile;
+    auto invalidIfd = [this, tolerant, &offset](const QString &errorString) {
+        if (tolerant)
+            qCDebug(tiffLog) << "Stop scanning:" << errorString;
+        else
+            setError(errorString, offset);
+    };
+
+    bool chainEnded = true;
+    while (offset != 0) {
+        if (ifdOffsets.size() >= count) {
+            chainEnded = false;
+            break;
+        }
+        if (visitedIfdOffsets.contains(offset)) {
+            qCDebug(tiffLog) << "Ifd at offset" << offset << "is linked more than once";
+            break;
+        }
+        if (ifdBudget <= 0) {
+            qCDebug(tiffLog) << "Stop scanning, too many ifds:" << ifdOffsets.size();
+            break;
+        }
 
-    if (!header.isBigTiff()) {
-        quint16 deCount = getValueFromFile<quint16>();
-        for (int i = 0; i < deCount; ++i) {
-            TiffIfdEntry ifdEntry;
-            auto &dePrivate = ifdEntry.d;
-            dePrivate->tag = getValueFromFile<quint16>();
-            dePrivate->type = getValueFromFile<quint16>();
-            dePrivate->count = getValueFromFile<quint32>();
-            dePrivate->valueOrOffset = file.read(4);
-
-            ifd.d->ifdEntries.append(ifdEntry);
+        auto countBytes = source->readRaw(offset, countSize);
+        if (countBytes.size() != countSize) {
+            invalidIfd(QStringLiteral("Invalid ifd at offset %1").arg(offset));
+            break;
         }
-        ifd.d->nextIfdOffset = getValueFromFile<quint32>();
-    } else {
-        quint64 deCount = getValueFromFile<quint64>();
-        for (quint64 i = 0; i < deCount; ++i) {
-            TiffIfdEntry ifdEntry;
-            auto &dePrivate = ifdEntry.d;
-            dePrivate->tag = getValueFromFile<quint16>();
-            dePrivate->type = getValueFromFile<quint16>();
-            dePrivate->count = getValueFromFile<quint64>();
-            dePrivate->valueOrOffset = file.read(8);
-
-            ifd.d->ifdEntries.append(ifdEntry);
+        const quint64 deCount = Layout::entryCount(countBytes);
+        const qint64 tableBytes = source->bytesAvailable(offset, TiffDataSource::IfdRead);
+        if (deCount > static_cast<quint64>(tableBytes) / entrySize) {
+            invalidIfd(QStringLiteral("Invalid ifd at offset %1: too many entries").arg(offset));
+            break;
+        }
+
+        auto nextOffsetBytes =
+            source->readRaw(offset + countSize + deCount * entrySize, offsetSize);
+        if (nextOffsetBytes.size() != offsetSize) {
+            invalidIfd(QStringLiteral("Invalid ifd at offset %1").arg(offset));
+            break;
         }
-        ifd.d->nextIfdOffset = getValueFromFile<qint64>();
+        visitedIfdOffsets.insert(offset);
+        ifdOffsets.append(offset);
+        --ifdBudget;
+        offset = Layout::offset(nextOffsetBytes);
     }
+    nextScanOffset = chainEnded ? 0 : offset;
+    ifdOffsetsScanned = chainEnded;
+}
 
-    // parser data of ifdEntry
-    foreach (auto de, ifd.ifdEntries()) {
-        auto &dePrivate = de.d;
+/*
+ * Appends the ifds linked to the end of the chain since it was scanned, and
+ * returns their number. It must not be called while ifds are parsed.
+ */
+int TiffFilePrivate::refresh()
+{
+    TIFF_TRACE_SPAN("refresh");
+    // the ifds appended before the chain ends are found by the scan
+    if (header.rawBytes.isEmpty() || !ifdOffsetsScanned)
+        return 0;
+
+    source->remap();
+    const int oldCount = ifdOffsets.size();
+    (this->*rescanIfdOffsetsFunc)();
+    const int count = ifdOffsets.size() - oldCount;
+    if (count == 0)
+        return 0;
 
-        auto valueBytesCount = dePrivate->count * dePrivate->typeSize();
-        // skip unknown datatype
-        if (valueBytesCount == 0)
-            continue;
-        QByteArray valueBytes;
-        if (!header.isBigTiff() && valueBytesCount > 4) {
-            auto valueOffset = getValueFromBytes<quint32>(de.valueOrOffset(), header.byteOrder);
-            if (!file.seek(valueOffset))
-                qCDebug(tiffLog) << "Fail to seek pos: " << valueOffset;
-            valueBytes = file.read(valueBytesCount);
-        } else if (header.isBigTiff() && valueBytesCount > 8) {
-            auto valueOffset = getValueFromBytes<quint64>(de.valueOrOffset(), header.byteOrder);
-            if (!file.seek(valueOffset))
-                qCDebug(tiffLog) << "Fail to seek pos: " << valueOffset;
-            valueBytes = file.read(valueBytesCount);
-        } else {
-            valueBytes = dePrivate->valueOrOffset;
+    {
+        // the ifd which ended the chain has been written since it was scanned
+        QMutexLocker locker(&errorMutex);
+        if (hasError && incompleteIfdOffset >= 0
+            && visitedIfdOffsets.contains(incompleteIfdOffset)) {
+            qCDebug(tiffLog) << "Ifd at offset" << incompleteIfdOffset << "is complete now";
+            hasError = false;
+            errorString.clear();
+            incompleteIfdOffset = -1;
         }
-        dePrivate->parserValues(valueBytes, header.byteOrder);
     }
 
-    if (!parentIfd) // IFD0
-        ifds.append(ifd);
-    else // subIfd
-        parentIfd->d->subIfds.append(ifd);
+    ifds.resize(ifdOffsets.size());
+    ifdsParsed.resize(ifdOffsets.size());
+    // the last ifd was parsed before it was linked to the new ones
+    if (oldCount > 0 && ifdsParsed[oldCount - 1])
+        ifds[oldCount - 1].d->nextIfdOffset = ifdOffsets[oldCount];
+
+    if (!parserOptions.parseIfdsOnDemand) {
+        for (int i = oldCount; i < ifdOffsets.size(); ++i)
+            ifd(i);
+    }
+    return count;
+}
+
+/*
+ * Reads the ifd at offset and its sub ifds, as many of them as \a budget allows.
+ */
+TiffIfd TiffFilePrivate::readIfdTree(qint64 offset, SubIfdBudget *budget)
+{
+    TiffIfd ifd;
+    if (!readIfd(offset, &ifd))
+        return ifd;
+    if (parserOptions.parserSubIfds)
+        readSubIfds(ifd, offset, budget);
+    if (parserOptions.prefetchValues)
+        prefetchValues(ifd);
+    return ifd;
+}
 
-    if (parserOptions.parserSubIfds) {
+/*
+ * The sub ifd chains are walked with an explicit stack instead of recursion,
+ * and they are still read in the same order as they are listed in the file.
+ */
+void TiffFilePrivate::readSubIfds(const TiffIfd &ifd, qint64 offset, SubIfdBudget *budget)
+{
+    struct PendingIfd
+    {
+        qint64 offset;
+        TiffIfd parentIfd;
+        int depth;
+    };
+
+    QVector<PendingIfd> pendingIfds;
+    QSet<qint64> visitedOffsets;
+    visitedOffsets.insert(offset);
+
+    auto appendSubIfds = [&](const TiffIfd &parentIfd, int depth) {
+        if (depth > parserOptions.maxIfdDepth)
+            return;
         // Note:
         // SUBIFDs in Tiff with pyramid generated by Adobe Photoshop CS6(Windows) can not be
         // parsered here. Nevertheless, Tiff generated by Adobe Photoshop CC 2018 is OK.
-        TiffIfdEntry deSubIfd = ifd.d->ifdEntry(TiffIfdEntry::T_SubIfd);
-        foreach (auto subIfdOffset, deSubIfd.values()) {
-            // read sub ifds
-            readIfd(subIfdOffset.toULongLong(), &ifd);
+        const TiffIfdEntry deSubIfd = parentIfd.d->ifdEntry(TiffIfdEntry::T_SubIfd);
+        const int remaining = qMax(budget->available - budget->used, 0);
+        const qint64 count = qMin<quint64>(deSubIfd.count(), std::numeric_limits<int>::max());
+        budget->needed = qMax(budget->needed, budget->used + count);
+        const auto subIfdCount = qMin<quint64>(deSubIfd.count(), remaining);
+        for (auto i = subIfdCount; i > 0; --i) {
+            const qint64 subIfdOffset = parentIfd.d->unsignedValue(deSubIfd.m_index, i - 1);
+            if (subIfdOffset != 0)
+                pendingIfds.append({ subIfdOffset, parentIfd, depth });
+        }
+    };
+
+    appendSubIfds(ifd, 1);
+    while (!pendingIfds.isEmpty()) {
+        const auto pending = pendingIfds.takeLast();
+        if (visitedOffsets.contains(pending.offset)) {
+            qCDebug(tiffLog) << "Ifd at offset" << pending.offset << "is linked more than once";
+            continue;
+        }
+        if (budget->used >= budget->available) {
+            qCDebug(tiffLog) << "Stop parsing sub ifds, too many ifds";
+            budget->needed = qMax<qint64>(budget->needed, budget->used + 1);
+            break;
+        }
+        ++budget->used;
+        visitedOffsets.insert(pending.offset);
+
+        TiffIfd subIfd;
+        if (!readIfd(pending.offset, &subIfd))
+            continue;
+        pending.parentIfd.d->subIfds.append(subIfd);
+
+        // Next ifd in the chain, which will be read after the sub ifds of this one.
+        if (subIfd.nextIfdOffset() != 0)
+            pendingIfds.append({ subIfd.nextIfdOffset(), pending.parentIfd, pending.depth });
+        appendSubIfds(subIfd, pending.depth + 1);
+    }
+}
+
+/*
+ * Loads the out of line values of the ifd and its sub ifds. The value ranges are
+ * sorted by offset, and ranges which are at most prefetchGap bytes apart are
+ * read at once, so the file is read forward with as few reads as possible.
+ */
+void TiffFilePrivate::prefetchValues(const TiffIfd &ifd)
+{
+    TIFF_TRACE_SPAN("prefetchValues");
+    // The values of each ifd are decoded into one value block of the ifd.
+    struct PendingValues
+    {
+        TiffIfdPrivate *ifd;
+        int index;
+        int block;
+        qint64 valueIndex;
+        qint64 offset;
+    };
+    QVector<PendingValues> entries;
+    QVector<TiffIfd> pendingIfds{ ifd };
+    while (!pendingIfds.isEmpty()) {
+        const auto pendingIfd = pendingIfds.takeLast();
+        auto ifdPrivate = pendingIfd.d.data();
+        qint64 blockSize = 0;
+        for (int i = 0; i < ifdPrivate->entries.size(); ++i) {
+            const auto &de = ifdPrivate->entries[i];
+            const int typeSize = ifdPrivate->typeSize(i);
+            if (de.valuesLoaded || de.valueOffset < 0 || !typeSize)
+                continue;
+            const qint64 bytesAvailable =
+                source->bytesAvailable(de.valueOffset, TiffDataSource::ValueRead);
+            if (de.count > static_cast<quint64>(bytesAvailable) / typeSize
+                || ifdPrivate->referenceValues(i))
+                continue;
+            entries.append({ ifdPrivate, i, -1, blockSize, de.valueOffset });
+            blockSize += ifdPrivate->valueBlockSize(i);
+        }
+        if (blockSize) {
+            const int block = ifdPrivate->appendValueBlock(blockSize);
+            for (auto it = entries.rbegin(); it != entries.rend() && it->ifd == ifdPrivate; ++it)
+                it->block = block;
+        }
+        pendingIfds.append(pendingIfd.d->subIfds);
+    }
+
+    std::sort(entries.begin(), entries.end(),
+              [](const PendingValues &de1, const PendingValues &de2) {
+                  return de1.offset < de2.offset;
+              });
+
+    auto valueEnd = [](const PendingValues &de) {
+        return de.offset + de.ifd->valueBytesCount(de.index);
+    };
+    const qint64 gap = qMax(parserOptions.prefetchGap, 0);
+    for (int first = 0; first < entries.size();) {
+        const qint64 start = entries[first].offset;
+        qint64 end = valueEnd(entries[first]);
+        int last = first;
+        while (last + 1 < entries.size() && entries[last + 1].offset <= end + gap) {
+            ++last;
+            end = qMax(end, valueEnd(entries[last]));
+        }
+
+        TiffPhaseTimer timer(&source->counters, ValueDecodePhase);
+        source->counters.valueFetches.fetchAndAddRelaxed(1);
+        const auto bytes = source->readRaw(start, end - start);
+        for (int i = first; i <= last; ++i) {
+            const auto &de = entries[i];
+            if (bytes.size() >= valueEnd(de) - start)
+                de.ifd->setValueBytes(de.index, bytes.constData() + de.offset - start, de.block,
+                                      de.valueIndex);
+        }
+        first = last + 1;
+    }
+}
+
+TiffIfd TiffFilePrivate::ifd(int index)
+{
+    scanIfdOffsets(qint64(index) + 1);
+    if (index < 0 || index >= ifdOffsets.size())
+        return TiffIfd();
+
+    if (!ifdsParsed[index]) {
+        SubIfdBudget budget{ ifdBudget };
+        ifds[index] = readIfdTree(ifdOffsets[index], &budget);
+        ifdsParsed[index] = true;
+        ifdBudget -= budget.used;
+    }
+    return ifds[index];
+}
+
+/*
+ * Parses all the ifds which haven't been parsed yet.
+ */
+void TiffFilePrivate::parseIfds()
+{
+    scanIfdOffsets();
+    parseIfds(0, ifdOffsets.size());
+}
+
+/*
+ * Subtracts the sub ifds of \a ifd, which are dropped, from the parser counters.
+ */
+void TiffFilePrivate::uncountSubIfds(const TiffIfd &ifd)
+{
+    for (const auto &subIfd : std::as_const(ifd.d->subIfds)) {
+        uncountSubIfds(subIfd);
+        source->counters.ifds.fetchAndAddRelaxed(-1);
+        source->counters.entries.fetchAndAddRelaxed(-subIfd.d->entries.size());
+    }
+}
+
+/*
+ * Parses the ifds from \a first to \a end, excluded, which haven't been parsed yet.
+ * Once the offsets are known, each ifd can be parsed independently, so this is done
+ * in parallel when TiffParserOptions::parserThreadCount allows it. The result is the
+ * same as parsing them one by one.
+ *
+ * The threads don't know how many sub ifds the ifds before theirs take, so each tree
+ * is read with all the sub ifds which are left, and the trees take their share in
+ * chain order once they are all read. The trees which needed more than the ones
+ * before them left are read again with their share, as they would be one by one.
+ */
+void TiffFilePrivate::parseIfds(int first, int end)
+{
+    int threadCount = parserOptions.parserThreadCount;
+    if (threadCount <= 0)
+        threadCount = QThread::idealThreadCount();
+    threadCount = qMin(threadCount, end - first);
+
+    if (threadCount <= 1) {
+        for (int i = first; i < end; ++i)
+            ifd(i);
+        return;
+    }
+
+    TiffIfd *ifdData = ifds.data();
+    const bool *ifdParsedData = ifdsParsed.constData();
+    QVector<SubIfdBudget> budgets(end - first);
+    SubIfdBudget *budgetData = budgets.data();
+    QAtomicInt nextIndex{ first };
+    QSemaphore finishedThreads;
+
+    // The pool is shared by all the files, tasks which don't get a thread at once
+    // only start once the others have parsed all the ifds.
+    auto pool = g_parserThreadPool();
+    if (pool->maxThreadCount() < threadCount)
+        pool->setMaxThreadCount(threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+        pool->start([&, available = ifdBudget]() {
+            {
+                TiffPhaseTimer timer(&source->counters, DirectoryPhase,
+                                     TiffPhaseTimer::CpuTimeOnly);
+                for (int index = nextIndex.fetchAndAddRelaxed(1); index < end;
+                     index = nextIndex.fetchAndAddRelaxed(1)) {
+                    if (ifdParsedData[index])
+                        continue;
+                    auto &budget = budgetData[index - first];
+                    budget.available = available;
+                    ifdData[index] = readIfdTree(ifdOffsets.at(index), &budget);
+                }
+            }
+            finishedThreads.release();
+        });
+    }
+    {
+        // the time spent waiting is wall time, the workers add their own cpu time
+        TiffPhaseTimer timer(&source->counters, DirectoryPhase, TiffPhaseTimer::WallTimeOnly);
+        finishedThreads.acquire(threadCount);
+    }
+
+    for (int index = first; index < end; ++index) {
+        if (ifdsParsed[index])
+            continue;
+        ifdsParsed[index] = true;
+        auto &budget = budgets[index - first];
+        if (budget.needed > ifdBudget && ifds[index].isValid()) {
+            uncountSubIfds(ifds[index]);
+            ifds[index].d->subIfds.clear();
+            budget = SubIfdBudget{ ifdBudget };
+            readSubIfds(ifds[index], ifdOffsets[index], &budget);
+            if (parserOptions.prefetchValues)
+                prefetchValues(ifds[index]);
         }
+        ifdBudget -= budget.used;
+    }
+}
+
+template <typename Layout>
+bool TiffFilePrivate::readIfd(qint64 offset, TiffIfd *ifd)
+{
+    TIFF_TRACE_SPAN("readIfd", "offset", offset);
+    // The entry table is read with one call, so the number of reads per ifd
+    // doesn't depend on the number of entries.
+    const int countSize = Layout::countSize;
+    const int entrySize = Layout::entrySize;
+    const int offsetSize = Layout::offsetSize;
+
+    auto countBytes = source->readRaw(offset, countSize);
+    if (countBytes.size() != countSize) {
+        setError(QStringLiteral("Invalid ifd at offset %1").arg(offset));
+        return false;
+    }
+    const quint64 deCount = Layout::entryCount(countBytes);
+    const qint64 bytesAvailable = source->bytesAvailable(offset, TiffDataSource::IfdRead);
+    if (deCount > static_cast<quint64>(bytesAvailable) / entrySize) {
+        setError(QStringLiteral("Invalid ifd at offset %1: too many entries").arg(offset));
+        return false;
     }
 
-    if (ifd.nextIfdOffset() != 0) {
-        // Read next ifd in the chain
-        readIfd(ifd.nextIfdOffset(), parentIfd);
+    const qint64 tableSize = deCount * entrySize + offsetSize;
+    auto tableBytes = source->readRaw(offset + countSize, tableSize);
+    if (tableBytes.size() != tableSize) {
+        setError(QStringLiteral("Invalid ifd at offset %1").arg(offset));
+        return false;
+    }
+
+    auto ifdPrivate = ifd->d.data();
+    ifdPrivate->byteOrder = Layout::byteOrder;
+    ifdPrivate->offsetSize = offsetSize;
+    ifdPrivate->source = source;
+    ifdPrivate->entries.resize(deCount);
+
+    const char *entryBytes = tableBytes.constData();
+    for (quint64 i = 0; i < deCount; ++i, entryBytes += entrySize) {
+        auto &de = ifdPrivate->entries[i];
+        de.tag = Layout::template get<quint16>(entryBytes);
+        de.type = Layout::template get<quint16>(entryBytes + 2);
+        de.count = Layout::valueCount(entryBytes + 4);
+        memcpy(de.valueOrOffset, entryBytes + 4 + offsetSize, offsetSize);
+
+        // Only remember where the values are, they are loaded on demand.
+        const int typeSize = TiffIfdPrivate::dataTypeSize(de.type);
+        if (typeSize && de.count > static_cast<quint64>(offsetSize / typeSize))
+            de.valueOffset = Layout::offset(entryBytes + 4 + offsetSize);
     }
+    source->counters.ifds.fetchAndAddRelaxed(1);
+    source->counters.entries.fetchAndAddRelaxed(deCount);
+    ifdPrivate->nextIfdOffset = Layout::offset(entryBytes);
 
     return true;
 }
@@ -752,23 +2365,147 @@ bool TiffFilePrivate::readIfd(qint64 offset, TiffIfd *parentIfd)
 TiffFile::TiffFile(const QString &filePath, const TiffParserOptions &options)
     : d(new TiffFilePrivate)
 {
-    d->file.setFileName(filePath);
     d->parserOptions = options;
-    if (!d->file.open(QFile::ReadOnly)) {
+    d->filePath = filePath;
+    // taken before the file is read, so a later change never matches the cache key
+    const QFileInfo info(filePath);
+    d->fileSize = info.size();
+    d->fileModified = info.lastModified();
+    if (!d->source->open(filePath, options)) {
         d->hasError = true;
-        d->errorString = d->file.errorString();
+        d->errorString = d->source->errorString();
     }
+    d->parse();
+}
 
-    if (!d->readHeader())
-        return;
+/*!
+ * Constructs the TiffFile object from \a device, which is opened for reading if
+ * it isn't open yet. The tiff file starts at offset 0 of a random access device,
+ * or at the current position of a sequential device, which is read as a stream.
+ *
+ * The device isn't owned, and it must be kept open while values are loaded on demand.
+ */
+TiffFile::TiffFile(QIODevice *device, const TiffParserOptions &options)
+    : d(new TiffFilePrivate)
+{
+    d->parserOptions = options;
+    if (!d->source->open(device, options)) {
+        d->hasError = true;
+        d->errorString = d->source->errorString();
+    }
+    d->parse();
+}
+
+TiffFile::TiffFile(TiffFilePrivate *dd)
+    : d(dd)
+{
+}
 
-    d->readIfd(d->header.ifd0Offset);
+/*!
+ * Parses the tiff file held by \a data. The bytes are shared rather than copied,
+ * and values which don't need to be decoded, such as ASCII and UNDEFINED values,
+ * are used in place by the typed span accessors.
+ */
+TiffFile TiffFile::fromData(const QByteArray &data, const TiffParserOptions &options)
+{
+    auto dd = new TiffFilePrivate;
+    dd->parserOptions = options;
+    dd->source->open(data);
+    dd->parse();
+    return TiffFile(dd);
+}
+
+/*!
+ * \overload
+ *
+ * The \a size bytes at \a data are not copied, so they must be kept alive as long
+ * as the TiffFile and its ifds are used.
+ */
+TiffFile TiffFile::fromData(const char *data, qsizetype size, const TiffParserOptions &options)
+{
+    return fromData(QByteArray::fromRawData(data, size), options);
 }
 
 TiffFile::~TiffFile()
 {
 }
 
+/*!
+ * Returns the path the file is opened from, or an empty string if it's read from
+ * a device or from memory.
+ */
+QString TiffFile::filePath() const
+{
+    return d->filePath;
+}
+
+/*!
+ * Returns the size of the file when it was opened by path, or -1.
+ */
+qint64 TiffFile::fileSize() const
+{
+    return d->fileSize;
+}
+
+/*!
+ * Returns the modification time of the file when it was opened by path.
+ */
+QDateTime TiffFile::fileLastModified() const
+{
+    return d->fileModified;
+}
+
+/*!
+ * Returns a copy of this file, which can be used in another thread than this one,
+ * for instance to write it to TiffParseCache in the background. Ifds which have
+ * been parsed and values which have been loaded are copied too.
+ */
+TiffFile TiffFile::clone() const
+{
+    return TiffFile(new TiffFilePrivate(*d));
+}
+
+/*!
+ * Looks for ifds linked to the end of the ifd chain since it was scanned, which
+ * happens when pages are appended to a file while it's being written. Only the
+ * last known ifd and the new ones are read, and the number of new ifds is
+ * returned. They are parsed unless TiffParserOptions::parseIfdsOnDemand is set.
+ * If the chain ended with an incomplete ifd when it was scanned, the error is
+ * cleared once that ifd has been written. Nothing is done until the chain has been
+ * scanned to its end, the ifds appended before are found by the scan.
+ *
+ * A memory mapped file is mapped again when it has grown. The old mapping is kept
+ * until the ifds which use values from it are released, so the value spans
+ * returned before stay valid, as they do for ifds parsed from buffered reads.
+ */
+int TiffFile::refresh()
+{
+    TiffPhaseTimer timer(&d->source->counters, DirectoryPhase);
+    return d->refresh();
+}
+
+/*!
+ * Returns true if the ifds are restored from TiffParserOptions::cache.
+ */
+bool TiffFile::isLoadedFromCache() const
+{
+    return d->loadedFromCache;
+}
+
+/*!
+ * Returns the ifds in the form stored by TiffParseCache, with the values which
+ * have been loaded so far, or an empty array if the file has errors. Ifds which
+ * haven't been parsed yet are parsed first, values are not loaded.
+ */
+QByteArray TiffFile::cacheData() const
+{
+    TiffPhaseTimer timer(&d->source->counters, DirectoryPhase);
+    d->parseIfds();
+    if (d->hasError)
+        return QByteArray();
+    return d->cacheData();
+}
+
 QByteArray TiffFile::headerBytes() const
 {
     return d->header.rawBytes;
@@ -794,11 +2531,109 @@ qint64 TiffFile::ifd0Offset() const
     return d->header.ifd0Offset;
 }
 
+/*!
+ * Returns IFD0, IFD1, ... Ifds which haven't been parsed yet are parsed first.
+ */
 QVector<TiffIfd> TiffFile::ifds() const
 {
+    TiffPhaseTimer timer(&d->source->counters, DirectoryPhase);
+    d->parseIfds();
     return d->ifds;
 }
 
+/*!
+ * \overload
+ *
+ * Returns at most \a count ifds from IFD \a first. The ifds which haven't been
+ * parsed yet are parsed in parallel when TiffParserOptions::parserThreadCount
+ * allows it, so ifds parsed on demand are best fetched in batches with this.
+ */
+QVector<TiffIfd> TiffFile::ifds(int first, int count) const
+{
+    TiffPhaseTimer timer(&d->source->counters, DirectoryPhase);
+    d->scanIfdOffsets(qint64(qMax(first, 0)) + qMax(count, 0));
+    first = qBound(0, first, static_cast<int>(d->ifdOffsets.size()));
+    const int end = first + qBound(0, count, static_cast<int>(d->ifdOffsets.size()) - first);
+    d->parseIfds(first, end);
+    return d->ifds.mid(first, end - first);
+}
+
+/*!
+ * Returns the offsets of IFD0, IFD1, ... The chain is scanned the first time this
+ * is called, only the entry count and the next ifd offset of each ifd are read.
+ */
+QVector<qint64> TiffFile::scanIfdOffsets() const
+{
+    TiffPhaseTimer timer(&d->source->counters, DirectoryPhase);
+    d->scanIfdOffsets();
+    return d->ifdOffsets;
+}
+
+/*!
+ * Returns the number of ifds, the whole chain is scanned the first time this is
+ * called. See scanIfdChain() to use the first ifds before that.
+ */
+int TiffFile::ifdCount() const
+{
+    TiffPhaseTimer timer(&d->source->counters, DirectoryPhase);
+    d->scanIfdOffsets();
+    return d->ifdOffsets.size();
+}
+
+/*!
+ * Scans the ifd chain until at least \a count ifds are known or the chain ends,
+ * and returns the number of ifds known so far, so that the ifds of a long chain
+ * can be used while it's scanned a part at a time.
+ */
+int TiffFile::scanIfdChain(int count) const
+{
+    TiffPhaseTimer timer(&d->source->counters, DirectoryPhase);
+    d->scanIfdOffsets(count);
+    return d->ifdOffsets.size();
+}
+
+/*!
+ * Returns true once the ifd chain has been scanned to its end.
+ */
+bool TiffFile::isIfdChainScanned() const
+{
+    return d->ifdOffsetsScanned;
+}
+
+/*!
+ * Returns the ifd at \a index together with its sub ifds, which are parsed on
+ * demand when TiffParserOptions::parseIfdsOnDemand is set. The chain is only
+ * scanned as far as this ifd.
+ */
+TiffIfd TiffFile::ifd(int index) const
+{
+    TiffPhaseTimer timer(&d->source->counters, DirectoryPhase);
+    return d->ifd(index);
+}
+
+/*!
+ * Returns what parsing the file has cost so far. Values are loaded on demand,
+ * so the value counters keep growing while the entries are used.
+ */
+TiffParserStats TiffFile::stats() const
+{
+    const auto &counters = d->source->counters;
+    TiffParserStats stats;
+    stats.bytesRead = counters.bytesRead.loadRelaxed();
+    stats.readCalls = counters.readCalls.loadRelaxed();
+    stats.seeks = counters.seeks.loadRelaxed();
+    stats.ifdCount = counters.ifds.loadRelaxed();
+    stats.entryCount = counters.entries.loadRelaxed();
+    stats.valueFetches = counters.valueFetches.loadRelaxed();
+    stats.peakValueMemory = counters.peakValueMemory.loadRelaxed();
+    stats.headerNsecs = counters.phaseNsecs[HeaderPhase].loadRelaxed();
+    stats.directoryNsecs = counters.phaseNsecs[DirectoryPhase].loadRelaxed();
+    stats.valueDecodeNsecs = counters.phaseNsecs[ValueDecodePhase].loadRelaxed();
+    stats.directoryCpuNsecs = counters.phaseCpuNsecs[DirectoryPhase].loadRelaxed();
+    stats.valueDecodeCpuNsecs = counters.phaseCpuNsecs[ValueDecodePhase].loadRelaxed();
+    return stats;
+}
+
 QString TiffFile::errorString() const
 {
     return d->errorString;
@@ -29,13 +29,107 @@
 #include <QExplicitlySharedDataPointer>
 
 class QByteArray;
-class TiffIfdEntryPrivate;
+class QDateTime;
+class QIODevice;
+struct TiffIfdEntryRecord;
 class TiffIfdPrivate;
 class TiffFilePrivate;
+class TiffParseCache;
 
 struct TiffParserOptions
 {
     bool parserSubIfds{ true };
+    // Map the whole file into memory and parse from the mapped bytes.
+    // Falls back to buffered reads if the file can not be mapped.
+    bool useMemoryMap{ false };
+    // Only read the header when opening, ifds are parsed by TiffFile::ifd().
+    bool parseIfdsOnDemand{ false };
+    // Limits which keep parsing bounded for malformed files.
+    // maxIfds counts the ifds of all the chains, sub ifds included, in the order they
+    // are found. Ifds parsed on demand before the chain is scanned to its end take
+    // their sub ifds first, so they may leave fewer ifds for the end of the chain.
+    int maxIfds{ 1000000 };
+    int maxIfdDepth{ 16 }; // nesting level of sub ifds
+    // The file may still be written, so an incomplete ifd at the end of the chain
+    // isn't an error. It's read by TiffFile::refresh() once it has been written.
+    bool growingFile{ false };
+    // Threads used to parse the ifds once their offsets are known, 0 means one per core.
+    int parserThreadCount{ 1 };
+    // Read the out of line values of each ifd when it is parsed instead of on demand.
+    // Values are read in offset order, and values at most prefetchGap bytes apart
+    // are read with one call.
+    bool prefetchValues{ false };
+    int prefetchGap{ 4096 };
+
+    // Sequential devices, such as pipes and sockets, are read forward once, and
+    // at least the last streamBufferSize bytes are kept in memory. Older bytes
+    // are handled by the spill policy, as ifds and values may refer back to them.
+    enum StreamSpillPolicy { SpillToTemporaryFile, SpillToMemory, DiscardSpilled };
+    qint64 streamBufferSize{ 16 * 1024 * 1024 };
+    StreamSpillPolicy streamSpillPolicy{ SpillToTemporaryFile };
+    int streamReadTimeout{ 30000 }; // msecs to wait for more bytes, -1 to wait forever
+    // The size of a stream isn't known until it's read to the end, so larger entry
+    // tables and values of one entry are rejected instead of being read into memory.
+    qint64 maxStreamIfdSize{ 16 * 1024 * 1024 };
+    qint64 maxStreamValueSize{ 256 * 1024 * 1024 };
+
+    // Files opened by path are restored from this cache when they are in it, instead
+    // of being parsed. See TiffParseCache.
+    TiffParseCache *cache{ nullptr };
+};
+
+// Cost of parsing a file, see TiffFile::stats().
+struct TiffParserStats
+{
+    qint64 bytesRead{ 0 };
+    qint64 readCalls{ 0 };
+    qint64 seeks{ 0 }; // buffered reads only
+    qint64 ifdCount{ 0 }; // sub ifds included
+    qint64 entryCount{ 0 };
+    qint64 valueFetches{ 0 }; // out of line values read from the file
+    qint64 peakValueMemory{ 0 }; // bytes of the decoded values
+    // Wall time of each phase, values decoded while ifds are parsed are only counted
+    // in valueDecodeNsecs, so the phases don't overlap.
+    qint64 headerNsecs{ 0 };
+    qint64 directoryNsecs{ 0 };
+    qint64 valueDecodeNsecs{ 0 };
+    // CPU time of each phase, summed over the parser threads, which exceeds the wall
+    // time when ifds are parsed in parallel.
+    qint64 directoryCpuNsecs{ 0 };
+    qint64 valueDecodeCpuNsecs{ 0 };
+};
+
+/*!
+ * Read-only view of a contiguous array of values, which is valid as long as the
+ * TiffIfd of the TiffIfdEntry it comes from is alive.
+ */
+template <typename T>
+class TiffValueSpan
+{
+public:
+    TiffValueSpan() {}
+    TiffValueSpan(const T *data, qsizetype size)
+        : m_data(data)
+        , m_size(size)
+    {
+    }
+
+    const T *data() const { return m_data; }
+    qsizetype size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    const T &operator[](qsizetype index) const { return m_data[index]; }
+    const T *begin() const { return m_data; }
+    const T *end() const { return m_data + m_size; }
+
+private:
+    const T *m_data{ nullptr };
+    qsizetype m_size{ 0 };
+};
+
+struct TiffRational
+{
+    qint64 numerator{ 0 };
+    qint64 denominator{ 0 };
 };
 
 class TiffIfdEntry
@@ -77,15 +171,44 @@ public:
     QString tagName() const;
     quint16 type() const;
     QString typeName() const;
+
+    static QLatin1String tagName(quint16 tag);
+    static QLatin1String tagAlias(quint16 tag);
+    static QLatin1String typeName(quint16 type);
+    static QLatin1String compressionName(quint16 compression);
     quint64 count() const;
+    qsizetype valueCount() const;
     QByteArray valueOrOffset() const;
     QVariantList values() const;
     QString valueDescription() const;
     bool isValid() const;
 
+    // typed access, an empty span is returned if the type doesn't match
+    TiffValueSpan<quint8> toUInt8Span() const;
+    TiffValueSpan<qint8> toInt8Span() const;
+    TiffValueSpan<quint16> toUInt16Span() const;
+    TiffValueSpan<qint16> toInt16Span() const;
+    TiffValueSpan<quint32> toUInt32Span() const;
+    TiffValueSpan<qint32> toInt32Span() const;
+    TiffValueSpan<quint64> toUInt64Span() const;
+    TiffValueSpan<qint64> toInt64Span() const;
+    TiffValueSpan<float> toFloatSpan() const;
+    TiffValueSpan<double> toDoubleSpan() const;
+    TiffRational rationalAt(qsizetype index) const;
+
 private:
+    friend class TiffIfd;
+    friend class TiffIfdPrivate;
     friend class TiffFilePrivate;
-    QExplicitlySharedDataPointer<TiffIfdEntryPrivate> d;
+    TiffIfdEntry(TiffIfdPrivate *ifd, int index);
+    const TiffIfdEntryRecord &record() const;
+    const char *valueBytes() const;
+    template <typename T>
+    TiffValueSpan<T> valueSpan(bool typeMatched) const;
+
+    // An entry is a view of the entry at m_index of the ifd.
+    QExplicitlySharedDataPointer<TiffIfdPrivate> d;
+    int m_index{ -1 };
 };
 
 class TiffIfd
@@ -96,6 +219,8 @@ public:
     ~TiffIfd();
 
     QVector<TiffIfdEntry> ifdEntries() const;
+    int entryCount() const;
+    TiffIfdEntry ifdEntry(int index) const;
     QVector<TiffIfd> subIfds() const;
     qint64 nextIfdOffset() const;
     bool isValid() const;
@@ -111,10 +236,20 @@ public:
     enum ByteOrder { LittleEndian, BigEndian };
 
     TiffFile(const QString &filePath, const TiffParserOptions &options);
+    TiffFile(QIODevice *device, const TiffParserOptions &options);
     ~TiffFile();
 
+    static TiffFile fromData(const QByteArray &data, const TiffParserOptions &options);
+    static TiffFile fromData(const char *data, qsizetype size, const TiffParserOptions &options);
+
     QString errorString() const;
     bool hasError() const;
+    QString filePath() const;
+    qint64 fileSize() const;
+    QDateTime fileLastModified() const;
+    TiffFile clone() const;
+    bool isLoadedFromCache() const;
+    QByteArray cacheData() const;
 
     // header information
     QByteArray headerBytes() const;
@@ -125,7 +260,17 @@ public:
 
     // ifds
     QVector<TiffIfd> ifds() const;
+    QVector<TiffIfd> ifds(int first, int count) const;
+    QVector<qint64> scanIfdOffsets() const;
+    int ifdCount() const;
+    int scanIfdChain(int count) const;
+    bool isIfdChainScanned() const;
+    TiffIfd ifd(int index) const;
+    int refresh();
+
+    TiffParserStats stats() const;
 
 private:
+    explicit TiffFile(TiffFilePrivate *dd);
     QScopedPointer<TiffFilePrivate> d;
 };
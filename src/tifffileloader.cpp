@@ -0,0 +1,175 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#include "tifffileloader.h"
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <functional>
+
+// Parsed ifds are handed to the loader's thread in batches of this duration.
+static const int g_deliveryInterval = 50;
+
+class TiffFileLoaderPrivate
+{
+public:
+    TiffFileLoaderPrivate(TiffFileLoader *q);
+
+    void run(const QString &filePath, TiffParserOptions options, int generation);
+    void post(int generation, std::function<void()> func);
+
+    TiffFileLoader *q;
+    QThreadPool pool;
+    QSharedPointer<TiffFile> tiff;
+    QAtomicInt canceled;
+    int generation{ 0 };
+    bool running{ false };
+};
+
+TiffFileLoaderPrivate::TiffFileLoaderPrivate(TiffFileLoader *q)
+    : q(q)
+{
+    pool.setMaxThreadCount(1);
+}
+
+/*
+ * Runs \a func in the thread of the loader, unless the load it belongs to has been
+ * canceled or replaced by another one in the meantime.
+ */
+void TiffFileLoaderPrivate::post(int generation, std::function<void()> func)
+{
+    QMetaObject::invokeMethod(
+        q,
+        [this, generation, func]() {
+            if (generation == this->generation)
+                func();
+        },
+        Qt::QueuedConnection);
+}
+
+// Called in the worker thread.
+void TiffFileLoaderPrivate::run(const QString &filePath, TiffParserOptions options, int generation)
+{
+    options.parseIfdsOnDemand = true;
+    QSharedPointer<TiffFile> tiff(new TiffFile(filePath, options));
+    const int ifdCount = tiff->hasError() ? 0 : tiff->ifdCount();
+    post(generation, [this, tiff, ifdCount]() {
+        this->tiff = tiff;
+        emit q->opened(ifdCount);
+    });
+
+    QVector<TiffIfd> batch;
+    int batchFirst = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int index = 0; index < ifdCount && !canceled.loadRelaxed(); ++index) {
+        batch.append(tiff->ifd(index));
+        if (index + 1 < ifdCount && !timer.hasExpired(g_deliveryInterval))
+            continue;
+
+        post(generation, [this, batch, batchFirst, ifdCount]() {
+            const int currentGeneration = this->generation;
+            for (int i = 0; i < batch.size(); ++i) {
+                emit q->ifdParsed(batchFirst + i, batch[i]);
+                // a slot may have canceled the load
+                if (currentGeneration != this->generation)
+                    return;
+            }
+            emit q->progressChanged(batchFirst + batch.size(), ifdCount);
+        });
+        batchFirst = index + 1;
+        batch.clear();
+        timer.restart();
+    }
+
+    post(generation, [this]() {
+        running = false;
+        emit q->finished();
+    });
+}
+
+/*!
+ * \class TiffFileLoader
+ */
+TiffFileLoader::TiffFileLoader(QObject *parent)
+    : QObject(parent)
+    , d(new TiffFileLoaderPrivate(this))
+{
+}
+
+TiffFileLoader::~TiffFileLoader()
+{
+    cancel();
+}
+
+/*!
+ * Starts to load \a filePath in a worker thread, a load in progress is canceled
+ * first. opened() is emitted once the header has been read and the ifd offsets
+ * have been scanned, then ifdParsed() is emitted for each ifd, and finished() at
+ * the end, also when the file could not be parsed. The ifds are always parsed
+ * on demand, TiffParserOptions::parseIfdsOnDemand is ignored.
+ */
+void TiffFileLoader::open(const QString &filePath, const TiffParserOptions &options)
+{
+    cancel();
+
+    d->canceled.storeRelaxed(0);
+    d->tiff.reset();
+    d->running = true;
+    const int generation = ++d->generation;
+    d->pool.start(
+        [this, filePath, options, generation]() { d->run(filePath, options, generation); });
+}
+
+/*!
+ * Stops the current load. The worker thread is stopped after the ifd it is
+ * parsing, and no more signal is emitted for this load, finished() included.
+ */
+void TiffFileLoader::cancel()
+{
+    if (!d->running)
+        return;
+
+    d->canceled.storeRelaxed(1);
+    d->pool.waitForDone();
+    ++d->generation;
+    d->running = false;
+}
+
+bool TiffFileLoader::isRunning() const
+{
+    return d->running;
+}
+
+bool TiffFileLoader::isCanceled() const
+{
+    return d->canceled.loadRelaxed();
+}
+
+/*!
+ * Returns the file being loaded, or a null pointer before opened() is emitted.
+ */
+QSharedPointer<TiffFile> TiffFileLoader::tiffFile() const
+{
+    return d->tiff;
+}
@@ -0,0 +1,66 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#pragma once
+
+#include "tifffile.h"
+#include <QObject>
+#include <QSharedPointer>
+
+class TiffFileLoaderPrivate;
+
+/*!
+ * Opens and parses a tiff file in a worker thread.
+ *
+ * The ifds are delivered one by one through ifdParsed() in the order of the
+ * chain, so the first pages can be shown while the rest of a large file is still
+ * being parsed. All the signals are emitted in the thread the loader lives in.
+ *
+ * The header of tiffFile() can be used once opened() is emitted, the file itself
+ * must not be used for anything else until finished() is emitted.
+ */
+class TiffFileLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TiffFileLoader(QObject *parent = nullptr);
+    ~TiffFileLoader();
+
+    void open(const QString &filePath, const TiffParserOptions &options = TiffParserOptions());
+    void cancel();
+
+    bool isRunning() const;
+    bool isCanceled() const;
+    QSharedPointer<TiffFile> tiffFile() const;
+
+signals:
+    void opened(int ifdCount);
+    void ifdParsed(int index, const TiffIfd &ifd);
+    void progressChanged(int parsedIfdCount, int ifdCount);
+    void finished();
+
+private:
+    QScopedPointer<TiffFileLoaderPrivate> d;
+};
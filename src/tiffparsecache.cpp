@@ -0,0 +1,226 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#include "tiffparsecache.h"
+#include "tifffile.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+Q_DECLARE_LOGGING_CATEGORY(tiffLog)
+
+namespace {
+const quint32 CacheMagic = 0x54504331; // "TPC1"
+const quint32 CacheVersion = 1;
+
+// The file a cache entry is valid for.
+struct CacheKey
+{
+    QString filePath;
+    qint64 size{ -1 };
+    qint64 modified{ -1 };
+    QByteArray headerHash;
+
+    bool operator==(const CacheKey &other) const
+    {
+        return filePath == other.filePath && size == other.size && modified == other.modified
+            && headerHash == other.headerHash;
+    }
+};
+
+CacheKey cacheKey(const QString &filePath, qint64 fileSize, const QDateTime &lastModified,
+                  const QByteArray &headerBytes)
+{
+    CacheKey key;
+    if (filePath.isEmpty() || fileSize < 0 || !lastModified.isValid())
+        return key;
+    key.filePath = QFileInfo(filePath).canonicalFilePath();
+    key.size = fileSize;
+    key.modified = lastModified.toMSecsSinceEpoch();
+    key.headerHash = QCryptographicHash::hash(headerBytes, QCryptographicHash::Sha1);
+    return key;
+}
+
+QDataStream &operator<<(QDataStream &out, const CacheKey &key)
+{
+    return out << key.filePath << key.size << key.modified << key.headerHash;
+}
+
+QDataStream &operator>>(QDataStream &in, CacheKey &key)
+{
+    return in >> key.filePath >> key.size >> key.modified >> key.headerHash;
+}
+} // namespace
+
+/*!
+ * \class TiffParseCache
+ *
+ * The cache is stored in \a directory, which defaults to a directory in
+ * QStandardPaths::CacheLocation.
+ */
+
+TiffParseCache::TiffParseCache(const QString &directory)
+    : m_directory(directory)
+{
+    if (m_directory.isEmpty())
+        m_directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+            + QStringLiteral("/tiffparse");
+}
+
+TiffParseCache::~TiffParseCache()
+{
+}
+
+QString TiffParseCache::directory() const
+{
+    return m_directory;
+}
+
+void TiffParseCache::setMaxSize(qint64 bytes)
+{
+    m_maxSize = bytes;
+}
+
+qint64 TiffParseCache::maxSize() const
+{
+    return m_maxSize;
+}
+
+/*!
+ * Returns the cached data of \a filePath, which TiffFile restores its ifds from,
+ * or an empty array if the file isn't cached or has changed since. \a fileSize and
+ * \a lastModified are the ones of the file when it was opened.
+ */
+QByteArray TiffParseCache::find(const QString &filePath, qint64 fileSize,
+                                const QDateTime &lastModified,
+                                const QByteArray &headerBytes) const
+{
+    const auto key = cacheKey(filePath, fileSize, lastModified, headerBytes);
+    if (key.filePath.isEmpty())
+        return QByteArray();
+
+    QFile file(entryPath(key.filePath));
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != CacheMagic || version != CacheVersion)
+        return QByteArray();
+
+    CacheKey entryKey;
+    QByteArray data;
+    in >> entryKey >> data;
+    if (in.status() != QDataStream::Ok || !(entryKey == key)) {
+        qCDebug(tiffLog) << "Cache entry of" << filePath << "is out of date";
+        return QByteArray();
+    }
+    file.close();
+
+    // The modification time of an entry is the last time it was used.
+    if (file.open(QIODevice::Append))
+        file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+    return data;
+}
+
+/*!
+ * Adds or replaces the entry of \a tiff, which must have been opened by path.
+ * Ifds which haven't been parsed yet are parsed first, see TiffFile::cacheData().
+ * The entry is keyed by the size and modification time of the file when it was
+ * opened, so changes made since then invalidate it.
+ *
+ * \a tiff is used, so to write the entry in the background, insert a
+ * TiffFile::clone() of the file in the other thread.
+ */
+bool TiffParseCache::insert(const TiffFile &tiff)
+{
+    if (tiff.filePath().isEmpty() || tiff.hasError())
+        return false;
+    const auto key =
+        cacheKey(tiff.filePath(), tiff.fileSize(), tiff.fileLastModified(), tiff.headerBytes());
+    if (key.filePath.isEmpty())
+        return false;
+    const auto data = tiff.cacheData();
+    if (data.isEmpty() || data.size() > m_maxSize)
+        return false;
+
+    if (!QDir().mkpath(m_directory)) {
+        qCDebug(tiffLog) << "Fail to create cache directory" << m_directory;
+        return false;
+    }
+    QSaveFile file(entryPath(key.filePath));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCDebug(tiffLog) << "Fail to write cache entry:" << file.errorString();
+        return false;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << CacheMagic << CacheVersion << key << data;
+    if (!file.commit()) {
+        qCDebug(tiffLog) << "Fail to write cache entry:" << file.errorString();
+        return false;
+    }
+
+    evict(m_maxSize);
+    return true;
+}
+
+/*!
+ * Removes all the entries.
+ */
+void TiffParseCache::clear()
+{
+    evict(0);
+}
+
+QString TiffParseCache::entryPath(const QString &filePath) const
+{
+    const auto name = QCryptographicHash::hash(filePath.toUtf8(), QCryptographicHash::Sha1);
+    return QStringLiteral("%1/%2.tiffcache").arg(m_directory, QString::fromLatin1(name.toHex()));
+}
+
+/*
+ * Removes the least recently used entries until the cache is at most maxSize bytes.
+ */
+void TiffParseCache::evict(qint64 maxSize)
+{
+    QDir dir(m_directory);
+    const auto entries =
+        dir.entryInfoList({ QStringLiteral("*.tiffcache") }, QDir::Files, QDir::Time);
+    qint64 size = 0;
+    for (const auto &info : entries) {
+        size += info.size();
+        if (size > maxSize && !QFile::remove(info.filePath()))
+            qCDebug(tiffLog) << "Fail to remove cache entry" << info.filePath();
+    }
+}
@@ -0,0 +1,64 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+class QDateTime;
+class TiffFile;
+
+/*!
+ * Cache of parsed tiff files on disk, so reopening a file restores its ifds without
+ * parsing it again. The values which were loaded when the file was cached are
+ * restored too, the other ones are read from the file when they are used.
+ *
+ * Each file has its own cache entry, which is only used while the path, size,
+ * modification time and header of the file are the same as when it was opened.
+ * Entries are evicted in least recently used order when the cache grows over
+ * maxSize().
+ */
+class TiffParseCache
+{
+public:
+    explicit TiffParseCache(const QString &directory = QString());
+    ~TiffParseCache();
+
+    QString directory() const;
+    void setMaxSize(qint64 bytes);
+    qint64 maxSize() const;
+
+    QByteArray find(const QString &filePath, qint64 fileSize, const QDateTime &lastModified,
+                    const QByteArray &headerBytes) const;
+    bool insert(const TiffFile &tiff);
+    void clear();
+
+private:
+    QString entryPath(const QString &filePath) const;
+    void evict(qint64 maxSize);
+
+    QString m_directory;
+    qint64 m_maxSize{ 256 * 1024 * 1024 };
+};
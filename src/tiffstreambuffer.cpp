@@ -0,0 +1,160 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#include "tiffstreambuffer.h"
+#include <QIODevice>
+#include <QLoggingCategory>
+#include <QTemporaryFile>
+#include <limits>
+
+Q_DECLARE_LOGGING_CATEGORY(tiffLog)
+
+namespace {
+const qint64 ChunkSize = 64 * 1024;
+}
+
+/*!
+ * \class TiffStreamBuffer
+ *
+ * The device is only read from the position it has when this object is created,
+ * which is offset 0 of the tiff file.
+ */
+
+TiffStreamBuffer::TiffStreamBuffer(QIODevice *device, const TiffParserOptions &options)
+    : m_device(device)
+    , m_bufferSize(qMax<qint64>(options.streamBufferSize, 0))
+    , m_spillPolicy(options.streamSpillPolicy)
+    , m_readTimeout(options.streamReadTimeout)
+{
+}
+
+TiffStreamBuffer::~TiffStreamBuffer()
+{
+}
+
+/*!
+ * Returns the size of the stream once it has been read to the end. The size isn't
+ * known before, and the largest offset is returned, so offsets beyond the end are
+ * found when their bytes are read.
+ */
+qint64 TiffStreamBuffer::size() const
+{
+    return m_atEnd ? bytesReceived() : std::numeric_limits<qint64>::max();
+}
+
+/*!
+ * Returns at most \a maxSize bytes from \a offset. Bytes which haven't been
+ * received yet are waited for, and fewer bytes are returned if the stream ends
+ * before, or if the bytes have been dropped by the spill policy.
+ */
+QByteArray TiffStreamBuffer::read(qint64 offset, qint64 maxSize)
+{
+    if (offset < 0 || maxSize <= 0)
+        return QByteArray();
+    const qint64 end = maxSize > std::numeric_limits<qint64>::max() - offset
+        ? std::numeric_limits<qint64>::max()
+        : offset + maxSize;
+    receive(end, offset);
+
+    const qint64 readEnd = qMin(end, bytesReceived());
+    if (offset >= readEnd)
+        return QByteArray();
+    if (offset >= m_bufferStart)
+        return m_buffer.mid(offset - m_bufferStart, readEnd - offset);
+
+    // backward reference to bytes which have left the buffer
+    const qint64 spilledSize = qMin(readEnd, m_bufferStart) - offset;
+    auto bytes = readSpilled(offset, spilledSize);
+    if (bytes.size() == spilledSize && readEnd > m_bufferStart)
+        bytes.append(m_buffer.left(readEnd - m_bufferStart));
+    return bytes;
+}
+
+/*
+ * Reads the device until \a end is received or the stream ends. The bytes from
+ * \a keepFrom are kept in the buffer, as they are about to be returned.
+ */
+void TiffStreamBuffer::receive(qint64 end, qint64 keepFrom)
+{
+    while (!m_atEnd && bytesReceived() < end) {
+        // Only the requested bytes are read, as a producer may wait for our reply.
+        const auto chunk = m_device->read(qMin(end - bytesReceived(), ChunkSize));
+        if (chunk.isEmpty()) {
+            if (!m_device->waitForReadyRead(m_readTimeout)) {
+                qCDebug(tiffLog) << "Stream ends at" << bytesReceived() << m_device->errorString();
+                m_atEnd = true;
+            }
+            continue;
+        }
+        m_buffer.append(chunk);
+
+        // Bytes are moved out of the buffer in batches, so each byte is moved once.
+        if (m_spillPolicy != TiffParserOptions::SpillToMemory
+            && m_buffer.size() >= 2 * m_bufferSize + ChunkSize)
+            spill(qMin(keepFrom, bytesReceived() - m_bufferSize));
+    }
+}
+
+/*
+ * Moves the bytes before \a keepFrom out of the buffer.
+ */
+void TiffStreamBuffer::spill(qint64 keepFrom)
+{
+    const qint64 count = keepFrom - m_bufferStart;
+    if (count <= 0)
+        return;
+
+    if (m_spillPolicy == TiffParserOptions::SpillToTemporaryFile) {
+        if (!m_spillFile) {
+            m_spillFile.reset(new QTemporaryFile);
+            if (!m_spillFile->open()) {
+                qCDebug(tiffLog) << "Fail to create spill file, older bytes are dropped:"
+                                 << m_spillFile->errorString();
+                m_spillFile.reset();
+                m_spillPolicy = TiffParserOptions::DiscardSpilled;
+            }
+        }
+        if (m_spillFile
+            && (!m_spillFile->seek(m_bufferStart)
+                || m_spillFile->write(m_buffer.constData(), count) != count)) {
+            qCDebug(tiffLog) << "Fail to write spill file, older bytes are dropped:"
+                             << m_spillFile->errorString();
+            m_spillFile.reset();
+            m_spillPolicy = TiffParserOptions::DiscardSpilled;
+        }
+    }
+    m_buffer.remove(0, count);
+    m_bufferStart = keepFrom;
+}
+
+QByteArray TiffStreamBuffer::readSpilled(qint64 offset, qint64 maxSize)
+{
+    if (!m_spillFile) {
+        qCDebug(tiffLog) << "Bytes at offset" << offset << "have been dropped from the stream";
+        return QByteArray();
+    }
+    if (!m_spillFile->seek(offset))
+        return QByteArray();
+    return m_spillFile->read(maxSize);
+}
@@ -0,0 +1,68 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#pragma once
+
+#include "tifffile.h"
+#include <QByteArray>
+#include <QString>
+#include <memory>
+
+class QIODevice;
+class QTemporaryFile;
+
+/*!
+ * Random access to the bytes of a sequential device, such as a pipe or a socket.
+ *
+ * Bytes are read forward from the device when they are first requested, and the
+ * last bufferSize bytes are kept in memory. The bytes before them are kept in
+ * memory, written to a temporary file or dropped, following the spill policy,
+ * so that ifds and values can still refer back to them.
+ */
+class TiffStreamBuffer
+{
+public:
+    TiffStreamBuffer(QIODevice *device, const TiffParserOptions &options);
+    ~TiffStreamBuffer();
+
+    QByteArray read(qint64 offset, qint64 maxSize);
+    qint64 size() const;
+    qint64 bytesReceived() const { return m_bufferStart + m_buffer.size(); }
+    bool atEnd() const { return m_atEnd; }
+
+private:
+    void receive(qint64 end, qint64 keepFrom);
+    void spill(qint64 keepFrom);
+    QByteArray readSpilled(qint64 offset, qint64 maxSize);
+
+    QIODevice *m_device;
+    qint64 m_bufferSize;
+    TiffParserOptions::StreamSpillPolicy m_spillPolicy;
+    int m_readTimeout;
+
+    QByteArray m_buffer; // bytes from m_bufferStart to bytesReceived()
+    qint64 m_bufferStart{ 0 };
+    bool m_atEnd{ false };
+    std::unique_ptr<QTemporaryFile> m_spillFile; // bytes before m_bufferStart
+};
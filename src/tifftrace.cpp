@@ -0,0 +1,141 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#include "tifftrace.h"
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace {
+struct TraceEvent
+{
+    const char *name;
+    const char *argName;
+    qint64 arg;
+    qint64 startNsecs;
+    qint64 endNsecs;
+};
+
+struct TraceBuffer
+{
+    int threadId;
+    std::vector<TraceEvent> events;
+};
+
+std::atomic<bool> g_enabled{ false };
+QMutex g_buffersMutex;
+std::vector<std::unique_ptr<TraceBuffer>> g_buffers;
+
+/*
+ * The buffer of the current thread, buffers are kept after their threads are
+ * finished so that they can still be written.
+ */
+TraceBuffer *threadBuffer()
+{
+    thread_local TraceBuffer *buffer = nullptr;
+    if (!buffer) {
+        QMutexLocker locker(&g_buffersMutex);
+        g_buffers.emplace_back(new TraceBuffer{ static_cast<int>(g_buffers.size()) + 1, {} });
+        buffer = g_buffers.back().get();
+        buffer->events.reserve(4096);
+    }
+    return buffer;
+}
+
+QByteArray microseconds(qint64 nsecs)
+{
+    return QByteArray::number(nsecs / 1000.0, 'f', 3);
+}
+} // namespace
+
+void TiffTrace::start()
+{
+    nowNsecs();
+    g_enabled.store(true, std::memory_order_relaxed);
+}
+
+bool TiffTrace::isEnabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+/*
+ * Nanoseconds since the trace was started.
+ */
+qint64 TiffTrace::nowNsecs()
+{
+    static const auto startTime = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+                                                                - startTime)
+        .count();
+}
+
+void TiffTrace::addSpan(const char *name, qint64 startNsecs, qint64 endNsecs,
+                        const char *argName, qint64 arg)
+{
+    threadBuffer()->events.push_back({ name, argName, arg, startNsecs, endNsecs });
+}
+
+/*!
+ * Writes the spans recorded so far in the trace event format, which can be
+ * opened by chrome://tracing or ui.perfetto.dev. It should be called once the
+ * traced work is done, as the buffers are not locked while spans are recorded.
+ */
+bool TiffTrace::writeFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QMutexLocker locker(&g_buffersMutex);
+    QByteArray json("{\"traceEvents\":[\n");
+    bool first = true;
+    for (const auto &buffer : g_buffers) {
+        for (const auto &event : buffer->events) {
+            if (!first)
+                json.append(",\n");
+            first = false;
+            json.append("{\"name\":\"").append(event.name);
+            json.append("\",\"ph\":\"X\",\"pid\":1,\"tid\":");
+            json.append(QByteArray::number(buffer->threadId));
+            json.append(",\"ts\":").append(microseconds(event.startNsecs));
+            json.append(",\"dur\":").append(microseconds(event.endNsecs - event.startNsecs));
+            if (event.argName) {
+                json.append(",\"args\":{\"").append(event.argName).append("\":");
+                json.append(QByteArray::number(event.arg)).append('}');
+            }
+            json.append('}');
+            if (json.size() > 1024 * 1024) {
+                file.write(json);
+                json.clear();
+            }
+        }
+    }
+    json.append("\n]}\n");
+    return file.write(json) == json.size();
+}
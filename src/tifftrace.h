@@ -0,0 +1,77 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#pragma once
+
+#include <QtGlobal>
+
+class QString;
+
+/*!
+ * Records scoped spans, which can be written as a Chrome/Perfetto trace file.
+ *
+ * Each thread appends its spans to its own buffer, so recording doesn't lock,
+ * and nothing is recorded until start() is called.
+ */
+class TiffTrace
+{
+public:
+    static void start();
+    static bool isEnabled();
+    static bool writeFile(const QString &filePath);
+
+    static void addSpan(const char *name, qint64 startNsecs, qint64 endNsecs,
+                        const char *argName, qint64 arg);
+    static qint64 nowNsecs();
+};
+
+class TiffTraceSpan
+{
+public:
+    explicit TiffTraceSpan(const char *name, const char *argName = nullptr, qint64 arg = 0)
+        : m_name(name)
+        , m_argName(argName)
+        , m_arg(arg)
+        , m_start(TiffTrace::isEnabled() ? TiffTrace::nowNsecs() : -1)
+    {
+    }
+    ~TiffTraceSpan()
+    {
+        if (m_start != -1)
+            TiffTrace::addSpan(m_name, m_start, TiffTrace::nowNsecs(), m_argName, m_arg);
+    }
+
+private:
+    Q_DISABLE_COPY(TiffTraceSpan)
+
+    const char *m_name;
+    const char *m_argName;
+    qint64 m_arg;
+    qint64 m_start;
+};
+
+#define TIFF_TRACE_CONCAT_(a, b) a##b
+#define TIFF_TRACE_CONCAT(a, b) TIFF_TRACE_CONCAT_(a, b)
+// Records the rest of the current scope as a span, names must be string literals.
+#define TIFF_TRACE_SPAN(...) TiffTraceSpan TIFF_TRACE_CONCAT(tiffTraceSpan, __LINE__)(__VA_ARGS__)
@@ -0,0 +1,707 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#include "tifftreemodel.h"
+#include "tifftrace.h"
+#include <QLocale>
+#include <QStringList>
+#include <climits>
+#include <cstring>
+#include <vector>
+
+namespace {
+enum {
+    FetchBatchSize = 1000,
+    // Top level ifds are parsed on demand, so fetch fewer of them at a time.
+    IfdFetchBatchSize = 100,
+    // Ifds parsed at once by fetchMoreIfds(), which TiffFile can parse in parallel.
+    IfdParseBatchSize = 16,
+    // Only the first top level ifds are expanded, expanding all of them doesn't scale.
+    MaxExpandedIfds = 8
+};
+// Large value arrays are split into pages, which are only filled when expanded.
+enum { ValuePageSize = 1000 };
+
+QString escapedString(QString string)
+{
+    string.replace(QLatin1String("\r"), QLatin1String("\\r"));
+    string.replace(QLatin1String("\n"), QLatin1String("\\n"));
+    string.replace(QLatin1String("\t"), QLatin1String("\\t"));
+    string.replace(QLatin1String("\v"), QLatin1String("\\v"));
+    string.replace(QLatin1String("\b"), QLatin1String("\\b"));
+    return string;
+}
+
+quint64 firstUnsignedValue(const TiffIfdEntry &de)
+{
+    if (!de.toUInt16Span().isEmpty())
+        return de.toUInt16Span()[0];
+    if (!de.toUInt32Span().isEmpty())
+        return de.toUInt32Span()[0];
+    return 0;
+}
+} // namespace
+
+class TiffTreeNode
+{
+public:
+    enum Kind { Root, Header, HeaderField, Ifd, IfdField, Entry, EntryField, ValuePage, Value };
+    enum Field {
+        // header
+        ByteOrderField,
+        VersionField,
+        Ifd0OffsetField,
+        // ifd
+        EntriesCountField,
+        NextIfdOffsetField,
+        // ifd entry
+        TagField,
+        DataTypeField,
+        CountField,
+        ValueOrOffsetField,
+        ValuesField
+    };
+
+    TiffTreeNode(Kind kind, TiffTreeNode *parent, int row, int field = 0)
+        : kind(kind)
+        , parent(parent)
+        , row(row)
+        , field(field)
+    {
+    }
+    virtual ~TiffTreeNode() {}
+
+    Kind kind;
+    TiffTreeNode *parent;
+    int row;
+    int field; // Field of field nodes, index of value pages, or index of value nodes
+    std::vector<std::unique_ptr<TiffTreeNode>> children;
+};
+
+class TiffIfdNode : public TiffTreeNode
+{
+public:
+    TiffIfdNode(TiffTreeNode *parent, int row, const TiffIfd &ifd)
+        : TiffTreeNode(Ifd, parent, row)
+        , ifd(ifd)
+    {
+    }
+
+    TiffIfd ifd;
+};
+
+class TiffEntryNode : public TiffTreeNode
+{
+public:
+    TiffEntryNode(TiffTreeNode *parent, int row, const TiffIfdEntry &entry)
+        : TiffTreeNode(Entry, parent, row)
+        , entry(entry)
+    {
+    }
+
+    qint64 valueCount();
+    bool hasValuePages();
+    QString valueString(qint64 index, int maxLength = -1);
+    QString summary(int length);
+
+    TiffIfdEntry entry;
+
+private:
+    const QVector<qint64> &asciiStarts();
+
+    bool m_asciiStartsLoaded{ false };
+    QVector<qint64> m_asciiStarts;
+    int m_summaryLength{ -1 };
+    QString m_summary;
+};
+
+/*
+ * Number of values shown, which follows TiffIfdEntry::values(): ASCII values are split
+ * into strings, UNDEFINED values are shown as one value, and RATIONAL values take two.
+ */
+qint64 TiffEntryNode::valueCount()
+{
+    switch (entry.type()) {
+    case TiffIfdEntry::DT_Ascii:
+        return asciiStarts().size();
+    case TiffIfdEntry::DT_Undefined:
+        return entry.valueCount() ? 1 : 0;
+    case TiffIfdEntry::DT_Rational:
+    case TiffIfdEntry::DT_SRational:
+        return entry.valueCount() * 2;
+    default:
+        return entry.valueCount();
+    }
+}
+
+bool TiffEntryNode::hasValuePages()
+{
+    return valueCount() > ValuePageSize;
+}
+
+/*
+ * The value at \a index, ASCII strings and the UNDEFINED value which holds all the bytes
+ * can be limited to their first \a maxLength bytes.
+ */
+QString TiffEntryNode::valueString(qint64 index, int maxLength)
+{
+    switch (entry.type()) {
+    case TiffIfdEntry::DT_Ascii: {
+        const auto &starts = asciiStarts();
+        if (index < 0 || index >= starts.size())
+            return QString();
+        auto span = entry.toUInt8Span();
+        const auto start = starts[index];
+        auto size = (index + 1 < starts.size() ? starts[index + 1] : span.size()) - start;
+        if (maxLength >= 0)
+            size = qMin<qint64>(size, maxLength);
+        auto bytes = reinterpret_cast<const char *>(span.data()) + start;
+        return escapedString(QString::fromLatin1(bytes, size));
+    }
+    case TiffIfdEntry::DT_Undefined: {
+        auto span = entry.toUInt8Span();
+        const auto size = maxLength < 0 ? span.size() : qMin<qsizetype>(span.size(), maxLength);
+        return QString::fromUtf8(reinterpret_cast<const char *>(span.data()), size);
+    }
+    case TiffIfdEntry::DT_Byte:
+        return QString::number(entry.toUInt8Span()[index]);
+    case TiffIfdEntry::DT_SByte:
+        return QString::number(entry.toInt8Span()[index]);
+    case TiffIfdEntry::DT_Short:
+        return QString::number(entry.toUInt16Span()[index]);
+    case TiffIfdEntry::DT_SShort:
+        return QString::number(entry.toInt16Span()[index]);
+    case TiffIfdEntry::DT_Long:
+    case TiffIfdEntry::DT_Ifd:
+        return QString::number(entry.toUInt32Span()[index]);
+    case TiffIfdEntry::DT_SLong:
+        return QString::number(entry.toInt32Span()[index]);
+    case TiffIfdEntry::DT_Long8:
+    case TiffIfdEntry::DT_Ifd8:
+        return QString::number(entry.toUInt64Span()[index]);
+    case TiffIfdEntry::DT_SLong8:
+        return QString::number(entry.toInt64Span()[index]);
+    case TiffIfdEntry::DT_Float:
+        return QString::number(entry.toFloatSpan()[index], 'g', QLocale::FloatingPointShortest);
+    case TiffIfdEntry::DT_Double:
+        return QString::number(entry.toDoubleSpan()[index], 'g', QLocale::FloatingPointShortest);
+    case TiffIfdEntry::DT_Rational:
+    case TiffIfdEntry::DT_SRational: {
+        const auto rational = entry.rationalAt(index / 2);
+        return QString::number(index % 2 ? rational.denominator : rational.numerator);
+    }
+    default:
+        return QString();
+    }
+}
+
+/*
+ * Leading values joined by spaces, only as many values as fill \a length characters
+ * are formatted.
+ */
+QString TiffEntryNode::summary(int length)
+{
+    if (m_summaryLength == length)
+        return m_summary;
+    TIFF_TRACE_SPAN("summary", "tag", entry.tag());
+    m_summaryLength = length;
+    m_summary.clear();
+
+    const auto count = valueCount();
+    for (qint64 i = 0; i < count; ++i) {
+        if (i)
+            m_summary.append(QLatin1Char(' '));
+        m_summary.append(valueString(i, length + 1));
+        if (m_summary.size() > length) {
+            m_summary.truncate(length);
+            m_summary.append(QStringLiteral("..."));
+            break;
+        }
+    }
+
+    auto vd = entry.valueDescription();
+    if (!vd.isEmpty())
+        m_summary = QString("%1 [%2]").arg(m_summary, vd);
+    return m_summary;
+}
+
+/*
+ * Offsets of the NUL terminated strings of an ASCII value, as split by
+ * TiffIfdEntry::values(), the strings themselves are only converted when shown.
+ */
+const QVector<qint64> &TiffEntryNode::asciiStarts()
+{
+    if (!m_asciiStartsLoaded) {
+        m_asciiStartsLoaded = true;
+        auto span = entry.toUInt8Span();
+        const auto begin = span.data();
+        const auto end = begin + span.size();
+        for (auto p = begin; p < end;) {
+            m_asciiStarts.append(p - begin);
+            auto nul = static_cast<const quint8 *>(std::memchr(p, '\0', end - p));
+            p = nul ? nul + 1 : end;
+        }
+    }
+    return m_asciiStarts;
+}
+
+static TiffEntryNode *entryNodeOf(TiffTreeNode *node)
+{
+    while (node && node->kind != TiffTreeNode::Entry)
+        node = node->parent;
+    return static_cast<TiffEntryNode *>(node);
+}
+
+/*!
+ * \class TiffTreeModel
+ */
+
+TiffTreeModel::TiffTreeModel(QObject *parent)
+    : QAbstractItemModel(parent)
+    , m_root(new TiffTreeNode(TiffTreeNode::Root, nullptr, 0))
+{
+}
+
+TiffTreeModel::~TiffTreeModel()
+{
+}
+
+void TiffTreeModel::setTiffFile(const QSharedPointer<TiffFile> &tiff)
+{
+    beginResetModel();
+    m_tiff = tiff;
+    m_root.reset(new TiffTreeNode(TiffTreeNode::Root, nullptr, 0));
+    endResetModel();
+}
+
+QSharedPointer<TiffFile> TiffTreeModel::tiffFile() const
+{
+    return m_tiff;
+}
+
+void TiffTreeModel::clear()
+{
+    setTiffFile(QSharedPointer<TiffFile>());
+}
+
+/*!
+ * Sets the number of characters of the values summaries, which should be just
+ * enough to fill the value column. Summaries are rebuilt when shown again.
+ */
+void TiffTreeModel::setSummaryLength(int length)
+{
+    m_summaryLength = qMax(length, 1);
+}
+
+int TiffTreeModel::summaryLength() const
+{
+    return m_summaryLength;
+}
+
+/*!
+ * Returns true for the header and ifd items, which should be expanded when shown.
+ */
+bool TiffTreeModel::isExpandedByDefault(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return false;
+    auto node = nodeFromIndex(index);
+    if (node->kind == TiffTreeNode::Ifd)
+        return node->parent != m_root.get() || node->row <= MaxExpandedIfds;
+    return node->kind == TiffTreeNode::Header;
+}
+
+/*!
+ * Returns the number of top level ifd items created so far.
+ */
+int TiffTreeModel::ifdItemCount() const
+{
+    return qMax(static_cast<int>(m_root->children.size()) - 1, 0);
+}
+
+/*!
+ * Appends the header item and top level ifd items until the \a deadline expires.
+ * The header and IFD0 are appended whatever the deadline, and at least one item
+ * is appended if there are any left. All the items are inserted at once, and the
+ * number of ifd items appended is returned.
+ *
+ * The ifd chain is scanned as far as the ifds which are appended, so IFD0 is shown
+ * before the chain of a large file is scanned to its end.
+ */
+int TiffTreeModel::fetchMoreIfds(const QDeadlineTimer &deadline)
+{
+    if (!m_tiff)
+        return 0;
+    TIFF_TRACE_SPAN("fetchMoreIfds");
+
+    const int first = static_cast<int>(m_root->children.size());
+    int last = first - 1;
+    QVector<TiffIfd> ifds;
+    for (;;) {
+        if (last + 1 == 0) { // row 0 is the header
+            last = 0;
+        } else {
+            // the ifd of row last + 1 is ifd last, and IFD0 is fetched alone
+            const auto batch = m_tiff->ifds(last, last == 0 ? 1 : IfdParseBatchSize);
+            if (batch.isEmpty())
+                break;
+            ifds.append(batch);
+            last += batch.size();
+        }
+        if (last >= 1 && deadline.hasExpired())
+            break;
+    }
+    if (last < first)
+        return 0;
+
+    beginInsertRows(QModelIndex(), first, last);
+    auto ifdIt = ifds.cbegin();
+    for (int row = first; row <= last; ++row) {
+        if (row == 0)
+            m_root->children.emplace_back(new TiffTreeNode(TiffTreeNode::Header, m_root.get(), 0));
+        else
+            m_root->children.emplace_back(new TiffIfdNode(m_root.get(), row, *ifdIt++));
+    }
+    endInsertRows();
+    return ifds.size();
+}
+
+/*!
+ * Looks for ifds appended to the file, see TiffFile::refresh(), and returns their
+ * number. Their items are appended by fetchMoreIfds() like the other ifds.
+ */
+int TiffTreeModel::refresh()
+{
+    if (!m_tiff)
+        return 0;
+
+    const int oldIfdCount = m_tiff->scanIfdChain(0);
+    const int count = m_tiff->refresh();
+    if (count == 0 || ifdItemCount() != oldIfdCount || oldIfdCount == 0)
+        return count;
+
+    // NextIFDOffset of the ifd which was the last one, if its item is shown
+    auto ifdNode = m_root->children.back().get();
+    if (static_cast<qint64>(ifdNode->children.size()) == childCount(ifdNode)) {
+        auto fieldNode = ifdNode->children.back().get();
+        const auto fieldIndex = createIndex(fieldNode->row, 1, fieldNode);
+        emit dataChanged(fieldIndex, fieldIndex);
+    }
+    return count;
+}
+
+QModelIndex TiffTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (!hasIndex(row, column, parent))
+        return QModelIndex();
+    auto node = nodeFromIndex(parent);
+    return createIndex(row, column, node->children[row].get());
+}
+
+QModelIndex TiffTreeModel::parent(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return QModelIndex();
+    auto parentNode = nodeFromIndex(index)->parent;
+    if (!parentNode || parentNode == m_root.get())
+        return QModelIndex();
+    return createIndex(parentNode->row, 0, parentNode);
+}
+
+int TiffTreeModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0)
+        return 0;
+    return static_cast<int>(nodeFromIndex(parent)->children.size());
+}
+
+int TiffTreeModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return 2;
+}
+
+bool TiffTreeModel::hasChildren(const QModelIndex &parent) const
+{
+    if (parent.column() > 0)
+        return false;
+    return childCount(nodeFromIndex(parent)) > 0;
+}
+
+bool TiffTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (parent.column() > 0)
+        return false;
+    auto node = nodeFromIndex(parent);
+    // more ifds may be found until the chain is scanned to its end
+    if (node == m_root.get() && m_tiff && !m_tiff->isIfdChainScanned())
+        return true;
+    return static_cast<qint64>(node->children.size()) < childCount(node);
+}
+
+void TiffTreeModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.column() > 0)
+        return;
+    auto node = nodeFromIndex(parent);
+    const int batchSize = node == m_root.get() ? IfdFetchBatchSize : FetchBatchSize;
+    const int first = static_cast<int>(node->children.size());
+    // row 0 is the header, so the rows of the batch show up to first + batchSize - 1 ifds
+    if (node == m_root.get() && m_tiff)
+        m_tiff->scanIfdChain(first + batchSize - 1);
+    const int last = static_cast<int>(qMin<qint64>(childCount(node), first + batchSize)) - 1;
+    if (last < first)
+        return;
+    TIFF_TRACE_SPAN("fetchMore", "kind", node->kind);
+    // parses the ifds of the batch at once, which may be done in parallel
+    if (node == m_root.get())
+        m_tiff->ifds(qMax(first - 1, 0), last - qMax(first - 1, 0));
+
+    beginInsertRows(parent, first, last);
+    node->children.reserve(last + 1);
+    for (int row = first; row <= last; ++row)
+        createChild(node, row);
+    endInsertRows();
+}
+
+QVariant TiffTreeModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || role != Qt::DisplayRole)
+        return QVariant();
+
+    auto node = nodeFromIndex(index);
+    return index.column() == 0 ? nameText(node) : valueText(node);
+}
+
+QVariant TiffTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+    return section == 0 ? tr("Name") : tr("Value");
+}
+
+TiffTreeNode *TiffTreeModel::nodeFromIndex(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return m_root.get();
+    return static_cast<TiffTreeNode *>(index.internalPointer());
+}
+
+/*
+ * Number of children the node will have once all of them are fetched.
+ */
+qint64 TiffTreeModel::childCount(TiffTreeNode *node) const
+{
+    switch (node->kind) {
+    case TiffTreeNode::Root:
+        // the ifds found so far, the chain is scanned as the ifds are fetched
+        return m_tiff ? 1 + m_tiff->scanIfdChain(0) : 0;
+    case TiffTreeNode::Header:
+        return 3;
+    case TiffTreeNode::Ifd: {
+        const auto &ifd = static_cast<TiffIfdNode *>(node)->ifd;
+        return 2 + ifd.entryCount() + ifd.subIfds().size();
+    }
+    case TiffTreeNode::Entry:
+        return 5;
+    case TiffTreeNode::EntryField: {
+        if (node->field != TiffTreeNode::ValuesField)
+            return 0;
+        auto entryNode = entryNodeOf(node);
+        const auto count = entryNode->valueCount();
+        if (entryNode->hasValuePages())
+            return qMin<qint64>((count + ValuePageSize - 1) / ValuePageSize, INT_MAX);
+        return count;
+    }
+    case TiffTreeNode::ValuePage: {
+        const auto count = entryNodeOf(node)->valueCount();
+        return qMin<qint64>(count - qint64(node->field) * ValuePageSize, ValuePageSize);
+    }
+    default:
+        return 0;
+    }
+}
+
+void TiffTreeModel::createChild(TiffTreeNode *node, int row)
+{
+    TiffTreeNode *child = nullptr;
+    switch (node->kind) {
+    case TiffTreeNode::Root:
+        if (row == 0)
+            child = new TiffTreeNode(TiffTreeNode::Header, node, row);
+        else
+            child = new TiffIfdNode(node, row, m_tiff->ifd(row - 1));
+        break;
+    case TiffTreeNode::Header:
+        child = new TiffTreeNode(TiffTreeNode::HeaderField, node, row,
+                                 TiffTreeNode::ByteOrderField + row);
+        break;
+    case TiffTreeNode::Ifd: {
+        // EntriesCount, entries, sub ifds, NextIFDOffset
+        const auto &ifd = static_cast<TiffIfdNode *>(node)->ifd;
+        const int entriesCount = ifd.entryCount();
+        const int subIfdsCount = ifd.subIfds().size();
+        if (row == 0)
+            child = new TiffTreeNode(TiffTreeNode::IfdField, node, row,
+                                     TiffTreeNode::EntriesCountField);
+        else if (row <= entriesCount)
+            child = new TiffEntryNode(node, row, ifd.ifdEntry(row - 1));
+        else if (row <= entriesCount + subIfdsCount)
+            child = new TiffIfdNode(node, row, ifd.subIfds().at(row - 1 - entriesCount));
+        else
+            child = new TiffTreeNode(TiffTreeNode::IfdField, node, row,
+                                     TiffTreeNode::NextIfdOffsetField);
+        break;
+    }
+    case TiffTreeNode::Entry:
+        child = new TiffTreeNode(TiffTreeNode::EntryField, node, row, TiffTreeNode::TagField + row);
+        break;
+    case TiffTreeNode::EntryField:
+        if (entryNodeOf(node)->hasValuePages())
+            child = new TiffTreeNode(TiffTreeNode::ValuePage, node, row, row);
+        else
+            child = new TiffTreeNode(TiffTreeNode::Value, node, row, row);
+        break;
+    case TiffTreeNode::ValuePage:
+        child = new TiffTreeNode(TiffTreeNode::Value, node, row,
+                                 node->field * ValuePageSize + row);
+        break;
+    default:
+        return;
+    }
+    node->children.emplace_back(child);
+}
+
+QString TiffTreeModel::nameText(TiffTreeNode *node) const
+{
+    switch (node->kind) {
+    case TiffTreeNode::Header:
+        return tr("Header");
+    case TiffTreeNode::Ifd:
+        return tr("IFD");
+    case TiffTreeNode::Entry:
+        return tr("DE %1").arg(entryNodeOf(node)->entry.tagName());
+    case TiffTreeNode::ValuePage: {
+        const qint64 first = qint64(node->field) * ValuePageSize;
+        return tr("Value[%1..%2]").arg(first).arg(first + childCount(node) - 1);
+    }
+    case TiffTreeNode::Value:
+        return tr("Value[%1]").arg(node->field);
+    default:
+        break;
+    }
+
+    switch (node->field) {
+    case TiffTreeNode::ByteOrderField:
+        return tr("ByteOrder");
+    case TiffTreeNode::VersionField:
+        return tr("Version");
+    case TiffTreeNode::Ifd0OffsetField:
+        return tr("IFD0Offset");
+    case TiffTreeNode::EntriesCountField:
+        return tr("EntriesCount");
+    case TiffTreeNode::NextIfdOffsetField:
+        return tr("NextIFDOffset");
+    case TiffTreeNode::TagField:
+        return tr("Tag");
+    case TiffTreeNode::DataTypeField:
+        return tr("DataType");
+    case TiffTreeNode::CountField:
+        return tr("Count");
+    case TiffTreeNode::ValueOrOffsetField:
+        return tr("ValueOrOffset");
+    case TiffTreeNode::ValuesField:
+        return tr("Values");
+    default:
+        return QString();
+    }
+}
+
+QString TiffTreeModel::valueText(TiffTreeNode *node) const
+{
+    switch (node->kind) {
+    case TiffTreeNode::Header:
+        return QString::fromLatin1(m_tiff->headerBytes().toHex(' '));
+    case TiffTreeNode::HeaderField:
+        if (node->field == TiffTreeNode::ByteOrderField)
+            return QString("%1 (%2)")
+                .arg(m_tiff->headerBytes().left(2))
+                .arg(m_tiff->byteOrder() == TiffFile::BigEndian ? tr("BigEndian")
+                                                                : tr("LittleEndian"));
+        if (node->field == TiffTreeNode::VersionField)
+            return QString("%1 (%2)")
+                .arg(m_tiff->version())
+                .arg(m_tiff->isBigTiff() ? "BigTiff" : "Classic Tiff");
+        return QString::number(m_tiff->ifd0Offset());
+    case TiffTreeNode::Ifd: {
+        int width = -1;
+        int height = -1;
+        const auto &ifd = static_cast<TiffIfdNode *>(node)->ifd;
+        for (int i = 0; i < ifd.entryCount(); ++i) {
+            const auto de = ifd.ifdEntry(i);
+            if (de.tag() == TiffIfdEntry::T_ImageWidth)
+                width = firstUnsignedValue(de);
+            if (de.tag() == TiffIfdEntry::T_ImageLength)
+                height = firstUnsignedValue(de);
+        }
+        if (width != -1 && height != -1)
+            return tr("Image(%1x%2)").arg(width).arg(height);
+        return QString();
+    }
+    case TiffTreeNode::IfdField: {
+        const auto &ifd = static_cast<TiffIfdNode *>(node->parent)->ifd;
+        if (node->field == TiffTreeNode::EntriesCountField)
+            return QString::number(ifd.entryCount());
+        return QString::number(ifd.nextIfdOffset());
+    }
+    case TiffTreeNode::Entry: {
+        auto entryNode = entryNodeOf(node);
+        const auto &de = entryNode->entry;
+        return QString("Type=%2, Count=%3, Values=%4")
+            .arg(de.typeName())
+            .arg(de.count())
+            .arg(entryNode->summary(m_summaryLength));
+    }
+    case TiffTreeNode::EntryField: {
+        auto entryNode = entryNodeOf(node);
+        const auto &de = entryNode->entry;
+        switch (node->field) {
+        case TiffTreeNode::TagField:
+            return QString("%1 %2").arg(de.tagName()).arg(de.tag());
+        case TiffTreeNode::DataTypeField:
+            return QString("%1 %2").arg(de.typeName()).arg(de.type());
+        case TiffTreeNode::CountField:
+            return QString::number(de.count());
+        case TiffTreeNode::ValueOrOffsetField:
+            return QString::fromLatin1(de.valueOrOffset().toHex(' '));
+        default:
+            return entryNode->summary(m_summaryLength);
+        }
+    }
+    case TiffTreeNode::Value:
+        return entryNodeOf(node)->valueString(node->field);
+    default:
+        return QString();
+    }
+}
@@ -0,0 +1,83 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#pragma once
+
+#include "tifffile.h"
+#include <QAbstractItemModel>
+#include <QDeadlineTimer>
+#include <QSharedPointer>
+#include <memory>
+
+class TiffTreeNode;
+
+/*!
+ * Tree model of the header, ifds and ifd entries of a TiffFile.
+ *
+ * Rows are created on demand through canFetchMore()/fetchMore(), and texts are
+ * only formatted in data(), so the cost doesn't depend on the size of the file.
+ */
+class TiffTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    explicit TiffTreeModel(QObject *parent = nullptr);
+    ~TiffTreeModel();
+
+    void setTiffFile(const QSharedPointer<TiffFile> &tiff);
+    QSharedPointer<TiffFile> tiffFile() const;
+    void clear();
+
+    void setSummaryLength(int length);
+    int summaryLength() const;
+
+    bool isExpandedByDefault(const QModelIndex &index) const;
+
+    int ifdItemCount() const;
+    int fetchMoreIfds(const QDeadlineTimer &deadline);
+    int refresh();
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &index) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+private:
+    TiffTreeNode *nodeFromIndex(const QModelIndex &index) const;
+    qint64 childCount(TiffTreeNode *node) const;
+    void createChild(TiffTreeNode *node, int row);
+    QString nameText(TiffTreeNode *node) const;
+    QString valueText(TiffTreeNode *node) const;
+
+    QSharedPointer<TiffFile> m_tiff;
+    std::unique_ptr<TiffTreeNode> m_root;
+    int m_summaryLength{ 256 };
+};
@@ -0,0 +1,815 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#include "tifffile.h"
+#include "tiffgenerator.h"
+#include "tiffparsecache.h"
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtTest>
+
+/*
+ * Sequential device which hands out the bytes of a file in small chunks, as a
+ * pipe would.
+ */
+class StreamDevice : public QIODevice
+{
+public:
+    explicit StreamDevice(const QByteArray &data)
+        : m_data(data)
+    {
+    }
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override
+    {
+        return m_data.size() - m_pos + QIODevice::bytesAvailable();
+    }
+    bool waitForReadyRead(int) override { return false; }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        const qint64 size = qMin<qint64>(qMin<qint64>(maxSize, 1000), m_data.size() - m_pos);
+        memcpy(data, m_data.constData() + m_pos, size);
+        m_pos += size;
+        return size;
+    }
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    QByteArray m_data;
+    qint64 m_pos{ 0 };
+};
+
+class TiffFileTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void parallelParse_data();
+    void parallelParse();
+    void inputModes_data();
+    void inputModes();
+    void typedValues();
+    void byteOrder_data();
+    void byteOrder();
+    void names();
+    void ifdLoop();
+    void maxIfds();
+    void incrementalScan();
+    void maxIfdDepth_data();
+    void maxIfdDepth();
+    void parseCache();
+    void refresh_data();
+    void refresh();
+    void refreshAfterCacheHit();
+    void invalidGeneratorOptions_data();
+    void invalidGeneratorOptions();
+
+private:
+    static QByteArray generate(const TiffGeneratorOptions &options);
+    static QStringList dump(const TiffFile &tiff);
+    static void dumpIfd(const TiffIfd &ifd, const QString &prefix, QStringList *lines);
+    static int ifdDepth(const TiffIfd &ifd);
+    static int ifdTreeCount(const QVector<TiffIfd> &ifds);
+    bool writeFile(const QString &name, const QByteArray &data);
+
+    QTemporaryDir m_dir;
+    QByteArray m_pagesData; // pages with sub ifds, values scattered over the file
+};
+
+QByteArray TiffFileTest::generate(const TiffGeneratorOptions &options)
+{
+    TiffGenerator generator(options);
+    return generator.generate();
+}
+
+bool TiffFileTest::writeFile(const QString &name, const QByteArray &data)
+{
+    QFile file(m_dir.filePath(name));
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+/*
+ * Lists everything which is parsed from the file, so two files are parsed the same
+ * way when their dumps are equal.
+ */
+QStringList TiffFileTest::dump(const TiffFile &tiff)
+{
+    QStringList lines;
+    lines.append(QStringLiteral("header %1").arg(QString::fromLatin1(tiff.headerBytes().toHex())));
+    const auto ifds = tiff.ifds();
+    for (int i = 0; i < ifds.size(); ++i)
+        dumpIfd(ifds[i], QStringLiteral("ifd%1").arg(i), &lines);
+    return lines;
+}
+
+void TiffFileTest::dumpIfd(const TiffIfd &ifd, const QString &prefix, QStringList *lines)
+{
+    lines->append(QStringLiteral("%1 next %2").arg(prefix).arg(ifd.nextIfdOffset()));
+    for (const auto &de : ifd.ifdEntries()) {
+        QStringList values;
+        for (const auto &value : de.values()) {
+            values.append(value.typeId() == QMetaType::QByteArray
+                              ? QString::fromLatin1(value.toByteArray().toHex())
+                              : value.toString());
+        }
+        lines->append(QStringLiteral("%1 tag %2 type %3 count %4 %5: %6")
+                          .arg(prefix)
+                          .arg(de.tag())
+                          .arg(de.type())
+                          .arg(de.count())
+                          .arg(QString::fromLatin1(de.valueOrOffset().toHex()))
+                          .arg(values.join(QLatin1Char(' '))));
+    }
+    const auto subIfds = ifd.subIfds();
+    for (int i = 0; i < subIfds.size(); ++i)
+        dumpIfd(subIfds[i], QStringLiteral("%1.%2").arg(prefix).arg(i), lines);
+}
+
+int TiffFileTest::ifdDepth(const TiffIfd &ifd)
+{
+    int depth = 0;
+    for (const auto &subIfd : ifd.subIfds())
+        depth = qMax(depth, ifdDepth(subIfd) + 1);
+    return depth;
+}
+
+int TiffFileTest::ifdTreeCount(const QVector<TiffIfd> &ifds)
+{
+    int count = ifds.size();
+    for (const auto &ifd : ifds)
+        count += ifdTreeCount(ifd.subIfds());
+    return count;
+}
+
+void TiffFileTest::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    TiffGeneratorOptions options;
+    options.pageCount = 200;
+    options.arrayLength = 16;
+    options.subIfdCount = 2;
+    options.subIfdDepth = 2;
+    options.valuePlacement = TiffGeneratorOptions::ScatteredValues;
+    m_pagesData = generate(options);
+    QVERIFY(!m_pagesData.isEmpty());
+    QVERIFY(writeFile("pages.tif", m_pagesData));
+}
+
+void TiffFileTest::parallelParse_data()
+{
+    QTest::addColumn<bool>("bigTiff");
+    QTest::addColumn<int>("byteOrder");
+    QTest::addColumn<int>("valuePlacement");
+
+    QTest::newRow("classic") << false << int(TiffFile::LittleEndian)
+                             << int(TiffGeneratorOptions::ClusteredValues);
+    QTest::newRow("classic-be-inline") << false << int(TiffFile::BigEndian)
+                                       << int(TiffGeneratorOptions::InlineValues);
+    QTest::newRow("bigtiff-scattered") << true << int(TiffFile::LittleEndian)
+                                       << int(TiffGeneratorOptions::ScatteredValues);
+}
+
+/*
+ * Ifds parsed by several threads are the same as the ones parsed in file order.
+ */
+void TiffFileTest::parallelParse()
+{
+    QFETCH(bool, bigTiff);
+    QFETCH(int, byteOrder);
+    QFETCH(int, valuePlacement);
+
+    TiffGeneratorOptions generatorOptions;
+    generatorOptions.bigTiff = bigTiff;
+    generatorOptions.byteOrder = TiffFile::ByteOrder(byteOrder);
+    generatorOptions.pageCount = 100;
+    generatorOptions.arrayLength = 8;
+    generatorOptions.subIfdCount = 2;
+    generatorOptions.subIfdDepth = 2;
+    generatorOptions.valuePlacement = TiffGeneratorOptions::ValuePlacement(valuePlacement);
+    TiffGenerator generator(generatorOptions);
+    const auto data = generator.generate();
+    QVERIFY(!data.isEmpty());
+
+    TiffParserOptions options;
+    options.parserThreadCount = 1;
+    const auto sequential = TiffFile::fromData(data, options);
+    QVERIFY(!sequential.hasError());
+    QCOMPARE(sequential.ifdCount(), generatorOptions.pageCount);
+    QCOMPARE(ifdTreeCount(sequential.ifds()), generator.ifdCount());
+
+    for (int threadCount : { 0, 4 }) {
+        options.parserThreadCount = threadCount;
+        const auto parallel = TiffFile::fromData(data, options);
+        QVERIFY(!parallel.hasError());
+        QCOMPARE(dump(parallel), dump(sequential));
+        QCOMPARE(parallel.stats().ifdCount, sequential.stats().ifdCount);
+    }
+
+    // ifds parsed in batches on demand
+    options.parseIfdsOnDemand = true;
+    const auto onDemand = TiffFile::fromData(data, options);
+    for (int i = 0; i < onDemand.ifdCount(); i += 16)
+        QCOMPARE(onDemand.ifds(i, 16).size(), qMin(16, onDemand.ifdCount() - i));
+    QCOMPARE(dump(onDemand), dump(sequential));
+}
+
+void TiffFileTest::inputModes_data()
+{
+    QTest::addColumn<bool>("prefetchValues");
+
+    QTest::newRow("on demand") << false;
+    QTest::newRow("prefetch") << true;
+}
+
+/*
+ * Files are parsed the same way whatever they are read from.
+ */
+void TiffFileTest::inputModes()
+{
+    QFETCH(bool, prefetchValues);
+
+    TiffParserOptions options;
+    options.prefetchValues = prefetchValues;
+    const auto expected = dump(TiffFile::fromData(m_pagesData, options));
+    QVERIFY(expected.size() > 200);
+
+    const auto filePath = m_dir.filePath("pages.tif");
+    {
+        TiffFile tiff(filePath, options);
+        QVERIFY(!tiff.hasError());
+        QCOMPARE(dump(tiff), expected);
+    }
+    {
+        auto mapOptions = options;
+        mapOptions.useMemoryMap = true;
+        TiffFile tiff(filePath, mapOptions);
+        QVERIFY(!tiff.hasError());
+        QCOMPARE(dump(tiff), expected);
+    }
+    {
+        QBuffer buffer(&m_pagesData);
+        TiffFile tiff(&buffer, options);
+        QVERIFY(!tiff.hasError());
+        QCOMPARE(dump(tiff), expected);
+    }
+
+    // Values are scattered before and after their ifds, and the buffer is much smaller
+    // than the file, so the stream has to go back to spilled bytes.
+    for (auto policy : { TiffParserOptions::SpillToTemporaryFile,
+                         TiffParserOptions::SpillToMemory }) {
+        auto streamOptions = options;
+        streamOptions.streamBufferSize = 1024;
+        streamOptions.streamSpillPolicy = policy;
+        streamOptions.streamReadTimeout = 0;
+        StreamDevice device(m_pagesData);
+        QVERIFY(device.open(QIODevice::ReadOnly));
+        TiffFile tiff(&device, streamOptions);
+        QVERIFY2(!tiff.hasError(), qPrintable(tiff.errorString()));
+        QCOMPARE(dump(tiff), expected);
+    }
+}
+
+/*
+ * Typed spans and rationalAt() only return the values of their own types, signed
+ * values are sign extended and unsigned ones aren't.
+ */
+void TiffFileTest::typedValues()
+{
+    auto appendValue = [](QByteArray *bytes, quint32 value, int size) {
+        for (int i = 0; i < size; ++i)
+            bytes->append(char(value >> (8 * i)));
+    };
+    QByteArray data("II*\0", 4);
+    auto appendEntry = [&](quint16 tag, quint16 type, quint32 count, quint32 value) {
+        appendValue(&data, tag, 2);
+        appendValue(&data, type, 2);
+        appendValue(&data, count, 4);
+        appendValue(&data, value, 4);
+    };
+    const int entryCount = 5;
+    const quint32 valuesOffset = 8 + 2 + 12 * entryCount + 4;
+    appendValue(&data, 8, 4);
+
+    appendValue(&data, entryCount, 2);
+    appendEntry(40000, TiffIfdEntry::DT_Byte, 4, 0x7f80ff01);
+    appendEntry(40001, TiffIfdEntry::DT_SByte, 4, 0x7f80ff01);
+    appendEntry(40002, TiffIfdEntry::DT_SShort, 2, 0x8000fffe);
+    appendEntry(40003, TiffIfdEntry::DT_Rational, 2, valuesOffset);
+    appendEntry(40004, TiffIfdEntry::DT_SRational, 1, valuesOffset + 16);
+    appendValue(&data, 0, 4);
+    for (quint32 value : { 1u, 3u, 0xffffffffu, 2u, 0xffffffffu, 2u })
+        appendValue(&data, value, 4);
+
+    const auto tiff = TiffFile::fromData(data, TiffParserOptions());
+    QVERIFY(!tiff.hasError());
+    const auto entries = tiff.ifd(0).ifdEntries();
+    QCOMPARE(entries.size(), entryCount);
+
+    const auto bytes = entries[0].toUInt8Span();
+    QCOMPARE(QVector<quint8>(bytes.begin(), bytes.end()), QVector<quint8>({ 1, 255, 128, 127 }));
+    QVERIFY(entries[0].toInt8Span().isEmpty());
+    QCOMPARE(entries[0].values(), QVariantList({ 1u, 255u, 128u, 127u }));
+
+    const auto signedBytes = entries[1].toInt8Span();
+    QCOMPARE(QVector<qint8>(signedBytes.begin(), signedBytes.end()),
+             QVector<qint8>({ 1, -1, -128, 127 }));
+    QVERIFY(entries[1].toUInt8Span().isEmpty());
+    QCOMPARE(entries[1].values(), QVariantList({ 1, -1, -128, 127 }));
+
+    const auto shorts = entries[2].toInt16Span();
+    QCOMPARE(QVector<qint16>(shorts.begin(), shorts.end()), QVector<qint16>({ -2, -32768 }));
+    QVERIFY(entries[2].toUInt16Span().isEmpty());
+    QCOMPARE(entries[2].rationalAt(0).denominator, qint64(0));
+
+    QVERIFY(entries[3].toUInt32Span().isEmpty());
+    QCOMPARE(entries[3].rationalAt(0).numerator, qint64(1));
+    QCOMPARE(entries[3].rationalAt(0).denominator, qint64(3));
+    QCOMPARE(entries[3].rationalAt(1).numerator, qint64(0xffffffff));
+    QCOMPARE(entries[3].rationalAt(1).denominator, qint64(2));
+    QCOMPARE(entries[3].rationalAt(2).denominator, qint64(0));
+    QCOMPARE(entries[3].rationalAt(-1).denominator, qint64(0));
+
+    QCOMPARE(entries[4].rationalAt(0).numerator, qint64(-1));
+    QCOMPARE(entries[4].rationalAt(0).denominator, qint64(2));
+    QCOMPARE(entries[4].values(), QVariantList({ -1, 2 }));
+}
+
+void TiffFileTest::byteOrder_data()
+{
+    QTest::addColumn<bool>("bigTiff");
+    QTest::addColumn<int>("valuePlacement");
+    QTest::addColumn<int>("checkedEntries");
+
+    // Each of the 7 checked types has two entries, inline arrays are shortened so
+    // that only the SBYTE and SSHORT ones keep their 3 values.
+    QTest::newRow("classic") << false << int(TiffGeneratorOptions::ClusteredValues) << 14;
+    QTest::newRow("bigtiff") << true << int(TiffGeneratorOptions::ClusteredValues) << 14;
+    QTest::newRow("bigtiff-inline") << true << int(TiffGeneratorOptions::InlineValues) << 4;
+}
+
+/*
+ * Values of every type are the same in big and little endian files, whether they
+ * are swapped in place, out of line or inline.
+ */
+void TiffFileTest::byteOrder()
+{
+    QFETCH(bool, bigTiff);
+    QFETCH(int, valuePlacement);
+    QFETCH(int, checkedEntries);
+
+    TiffGeneratorOptions generatorOptions;
+    generatorOptions.bigTiff = bigTiff;
+    generatorOptions.pageCount = 2;
+    generatorOptions.entriesPerIfd = 12 + 16;
+    generatorOptions.mixedValueTypes = true;
+    generatorOptions.valuePlacement = TiffGeneratorOptions::ValuePlacement(valuePlacement);
+    const auto littleEndian = TiffFile::fromData(generate(generatorOptions), TiffParserOptions());
+    generatorOptions.byteOrder = TiffFile::BigEndian;
+    const auto bigEndian = TiffFile::fromData(generate(generatorOptions), TiffParserOptions());
+    QVERIFY(!bigEndian.hasError());
+    QCOMPARE(bigEndian.byteOrder(), TiffFile::BigEndian);
+    QCOMPARE(bigEndian.ifdCount(), 2);
+
+    for (int i = 0; i < bigEndian.ifdCount(); ++i) {
+        const auto expected = littleEndian.ifd(i).ifdEntries();
+        const auto entries = bigEndian.ifd(i).ifdEntries();
+        QCOMPARE(entries.size(), expected.size());
+        for (int j = 0; j < entries.size(); ++j)
+            QCOMPARE(entries[j].values(), expected[j].values());
+    }
+
+    // values of the generator, see mixedTypeEntry()
+    int checked = 0;
+    for (const auto &entry : bigEndian.ifd(0).ifdEntries()) {
+        if (entry.tag() < 40000 || entry.valueCount() < 3)
+            continue;
+        const int index = entry.tag() - 40000;
+        switch (entry.type()) {
+        case TiffIfdEntry::DT_SByte:
+            QCOMPARE(entry.toInt8Span()[1], qint8(0x08));
+            QCOMPARE(entry.toInt8Span()[2], qint8(-2));
+            break;
+        case TiffIfdEntry::DT_SShort:
+            QCOMPARE(entry.toInt16Span()[1], qint16(0x0708));
+            QCOMPARE(entry.toInt16Span()[2], qint16(-2));
+            break;
+        case TiffIfdEntry::DT_SLong:
+            QCOMPARE(entry.toInt32Span()[1], qint32(0x05060708));
+            QCOMPARE(entry.toInt32Span()[2], qint32(-2));
+            break;
+        case TiffIfdEntry::DT_Long8:
+            QCOMPARE(entry.toUInt64Span()[0], quint64(index));
+            QCOMPARE(entry.toUInt64Span()[1], Q_UINT64_C(0x0102030405060708));
+            break;
+        case TiffIfdEntry::DT_SLong8:
+            QCOMPARE(entry.toInt64Span()[1], Q_INT64_C(0x0102030405060708));
+            QCOMPARE(entry.toInt64Span()[2], qint64(-2));
+            break;
+        case TiffIfdEntry::DT_Float:
+            QCOMPARE(entry.toFloatSpan()[0], index + 0.5f);
+            QCOMPARE(entry.toFloatSpan()[1], -1.25f);
+            QCOMPARE(entry.toFloatSpan()[2], 3e38f);
+            break;
+        case TiffIfdEntry::DT_Double:
+            QCOMPARE(entry.toDoubleSpan()[0], index + 0.5);
+            QCOMPARE(entry.toDoubleSpan()[1], -1.25);
+            QCOMPARE(entry.toDoubleSpan()[2], 3e38);
+            break;
+        default:
+            continue;
+        }
+        ++checked;
+    }
+    QCOMPARE(checked, checkedEntries);
+}
+
+/*
+ * Names are looked up in sorted tables, the first and last codes included, codes
+ * with two names have an alias and unknown codes have no name.
+ */
+void TiffFileTest::names()
+{
+    QCOMPARE(QString(TiffIfdEntry::tagName(254)), QStringLiteral("SUBFILETYPE"));
+    QCOMPARE(QString(TiffIfdEntry::tagName(256)), QStringLiteral("IMAGEWIDTH"));
+    QCOMPARE(QString(TiffIfdEntry::tagName(65535)), QStringLiteral("DCSHUESHIFTVALUES"));
+    QCOMPARE(QString(TiffIfdEntry::tagName(292)), QStringLiteral("T4OPTIONS"));
+    QCOMPARE(QString(TiffIfdEntry::tagAlias(292)), QStringLiteral("GROUP3OPTIONS"));
+    QCOMPARE(QString(TiffIfdEntry::tagName(293)), QStringLiteral("T6OPTIONS"));
+    QCOMPARE(QString(TiffIfdEntry::tagAlias(293)), QStringLiteral("GROUP4OPTIONS"));
+    QVERIFY(TiffIfdEntry::tagAlias(256).isEmpty());
+    for (quint16 tag : { 0, 253, 40000 }) {
+        QVERIFY(TiffIfdEntry::tagName(tag).isEmpty());
+        QVERIFY(TiffIfdEntry::tagAlias(tag).isEmpty());
+    }
+
+    QCOMPARE(QString(TiffIfdEntry::compressionName(1)), QStringLiteral("NONE"));
+    QCOMPARE(QString(TiffIfdEntry::compressionName(3)), QStringLiteral("CCITT_T4"));
+    QCOMPARE(QString(TiffIfdEntry::compressionName(32773)), QStringLiteral("PACKBITS"));
+    QCOMPARE(QString(TiffIfdEntry::compressionName(50001)), QStringLiteral("WEBP"));
+    for (quint16 compression : { 0, 11, 65535 })
+        QVERIFY(TiffIfdEntry::compressionName(compression).isEmpty());
+
+    QCOMPARE(QString(TiffIfdEntry::typeName(TiffIfdEntry::DT_Byte)), QStringLiteral("BYTE"));
+    QCOMPARE(QString(TiffIfdEntry::typeName(TiffIfdEntry::DT_Ifd8)), QStringLiteral("IFD8"));
+    QVERIFY(TiffIfdEntry::typeName(0).isEmpty());
+    QVERIFY(TiffIfdEntry::typeName(TiffIfdEntry::DT_Ifd8 + 1).isEmpty());
+
+    // entries of unknown tags are still named, Compression values are described
+    TiffGeneratorOptions options;
+    options.entriesPerIfd = 13;
+    const auto tiff = TiffFile::fromData(generate(options), TiffParserOptions());
+    const auto entries = tiff.ifd(0).ifdEntries();
+    QCOMPARE(entries.last().tagName(), QStringLiteral("UNKNOWNTAG(40000)"));
+    for (const auto &entry : entries) {
+        if (entry.tag() == TiffIfdEntry::T_Compression)
+            QCOMPARE(entry.valueDescription(), QStringLiteral("NONE"));
+    }
+}
+
+/*
+ * Ifds linked more than once are only read once, so chains which loop end.
+ */
+void TiffFileTest::ifdLoop()
+{
+    QByteArray data("II*\0", 4);
+    auto appendValue = [&data](quint32 value, int size) {
+        for (int i = 0; i < size; ++i)
+            data.append(char(value >> (8 * i)));
+    };
+    auto appendEntry = [&](quint16 tag, quint16 type, quint32 value) {
+        appendValue(tag, 2);
+        appendValue(type, 2);
+        appendValue(1, 4);
+        appendValue(value, 4);
+    };
+    appendValue(8, 4);
+
+    // ifd0 at 8, its sub ifd is itself
+    appendValue(2, 2);
+    appendEntry(TiffIfdEntry::T_ImageWidth, TiffIfdEntry::DT_Short, 1);
+    appendEntry(TiffIfdEntry::T_SubIfd, TiffIfdEntry::DT_Long, 8);
+    appendValue(38, 4);
+    // ifd1 at 38, which links back to ifd0
+    appendValue(1, 2);
+    appendEntry(TiffIfdEntry::T_ImageWidth, TiffIfdEntry::DT_Short, 2);
+    appendValue(8, 4);
+
+    const auto tiff = TiffFile::fromData(data, TiffParserOptions());
+    QVERIFY(!tiff.hasError());
+    QCOMPARE(tiff.ifdCount(), 2);
+    QCOMPARE(tiff.ifd(0).subIfds().size(), 0);
+    QCOMPARE(tiff.ifd(1).nextIfdOffset(), qint64(8));
+}
+
+void TiffFileTest::maxIfds()
+{
+    TiffGeneratorOptions generatorOptions;
+    generatorOptions.pageCount = 10;
+    generatorOptions.subIfdCount = 2;
+    const auto data = generate(generatorOptions);
+
+    TiffParserOptions options;
+    options.maxIfds = 4;
+    const auto pages = TiffFile::fromData(data, options);
+    QCOMPARE(pages.ifdCount(), 4);
+    QCOMPARE(ifdTreeCount(pages.ifds()), 4);
+
+    // sub ifds are counted too, and the same ones are kept whatever the threads
+    options.maxIfds = 15;
+    const auto expected = dump(TiffFile::fromData(data, options));
+    for (int threadCount : { 1, 4 }) {
+        options.parserThreadCount = threadCount;
+        const auto tiff = TiffFile::fromData(data, options);
+        QCOMPARE(tiff.ifdCount(), 10);
+        QCOMPARE(ifdTreeCount(tiff.ifds()), 15);
+        QCOMPARE(dump(tiff), expected);
+        QCOMPARE(tiff.stats().ifdCount, qint64(15));
+    }
+}
+
+/*
+ * Ifds parsed on demand are found by scanning the chain only as far as needed.
+ */
+void TiffFileTest::incrementalScan()
+{
+    TiffGeneratorOptions generatorOptions;
+    generatorOptions.pageCount = 50;
+    generatorOptions.subIfdCount = 1;
+    const auto data = generate(generatorOptions);
+    TiffParserOptions options;
+    const auto expected = dump(TiffFile::fromData(data, options));
+
+    options.parseIfdsOnDemand = true;
+    const auto tiff = TiffFile::fromData(data, options);
+    QCOMPARE(tiff.scanIfdChain(0), 0);
+    QVERIFY(tiff.ifd(0).isValid());
+    QCOMPARE(tiff.scanIfdChain(0), 1);
+    QCOMPARE(tiff.scanIfdChain(10), 10);
+    QCOMPARE(tiff.ifds(20, 5).size(), 5);
+    QCOMPARE(tiff.scanIfdChain(0), 25);
+    QVERIFY(!tiff.isIfdChainScanned());
+    QCOMPARE(tiff.scanIfdChain(100), 50);
+    QVERIFY(tiff.isIfdChainScanned());
+    QCOMPARE(dump(tiff), expected);
+
+    // the ifds parsed before the end of the chain was found take their sub ifds first
+    options.maxIfds = 20;
+    const auto limited = TiffFile::fromData(data, options);
+    QCOMPARE(ifdTreeCount(limited.ifds(0, 5)), 10);
+    QCOMPARE(limited.ifdCount(), 15);
+    QCOMPARE(ifdTreeCount(limited.ifds()), 20);
+}
+
+void TiffFileTest::maxIfdDepth_data()
+{
+    QTest::addColumn<int>("maxIfdDepth");
+
+    QTest::newRow("0") << 0;
+    QTest::newRow("1") << 1;
+    QTest::newRow("2") << 2;
+    QTest::newRow("16") << 16;
+}
+
+void TiffFileTest::maxIfdDepth()
+{
+    QFETCH(int, maxIfdDepth);
+
+    TiffGeneratorOptions generatorOptions;
+    generatorOptions.pageCount = 2;
+    generatorOptions.subIfdCount = 1;
+    generatorOptions.subIfdDepth = 3;
+    const auto data = generate(generatorOptions);
+
+    TiffParserOptions options;
+    options.maxIfdDepth = maxIfdDepth;
+    const auto tiff = TiffFile::fromData(data, options);
+    QVERIFY(!tiff.hasError());
+    QCOMPARE(tiff.ifdCount(), 2);
+    for (const auto &ifd : tiff.ifds())
+        QCOMPARE(ifdDepth(ifd), qMin(maxIfdDepth, 3));
+}
+
+/*
+ * Ifds restored from the cache are the same as the parsed ones, values included.
+ */
+void TiffFileTest::parseCache()
+{
+    QTemporaryDir cacheDir;
+    QVERIFY(cacheDir.isValid());
+    TiffParseCache cache(cacheDir.path());
+    const auto filePath = m_dir.filePath("pages.tif");
+
+    TiffParserOptions options;
+    options.cache = &cache;
+    const auto expected = dump(TiffFile::fromData(m_pagesData, options));
+    {
+        TiffFile tiff(filePath, options);
+        QVERIFY(!tiff.isLoadedFromCache());
+        tiff.ifd(0).ifdEntries().first().values(); // cached with its values
+        QVERIFY(cache.insert(tiff.clone()));
+    }
+    {
+        TiffFile tiff(filePath, options);
+        QVERIFY(tiff.isLoadedFromCache());
+        QVERIFY(!tiff.hasError());
+        QCOMPARE(dump(tiff), expected);
+    }
+
+    // the entry is keyed by the file as it was opened, so a change made before it's
+    // inserted invalidates it
+    const auto changedPath = m_dir.filePath("cache-changed.tif");
+    QVERIFY(writeFile("cache-changed.tif", m_pagesData));
+    {
+        TiffFile tiff(changedPath, options);
+        QFile file(changedPath);
+        QVERIFY(file.open(QIODevice::Append));
+        QVERIFY(file.setFileTime(tiff.fileLastModified().addSecs(10),
+                                 QFileDevice::FileModificationTime));
+        file.close();
+        QVERIFY(cache.insert(tiff));
+    }
+    QVERIFY(!TiffFile(changedPath, options).isLoadedFromCache());
+
+    // the cache entry is only used with the same limits
+    options.maxIfdDepth = 1;
+    TiffFile tiff(filePath, options);
+    QVERIFY(!tiff.isLoadedFromCache());
+}
+
+void TiffFileTest::refresh_data()
+{
+    QTest::addColumn<bool>("useMemoryMap");
+    QTest::addColumn<bool>("growingFile");
+    QTest::addColumn<bool>("parseIfdsOnDemand");
+
+    QTest::newRow("buffered") << false << false << false;
+    QTest::newRow("mmap") << true << false << false;
+    QTest::newRow("growing") << false << true << false;
+    QTest::newRow("growing-mmap-on-demand") << true << true << true;
+}
+
+/*
+ * Pages appended to a file are found by refresh(), even if the last ifd was
+ * being written when the file was opened.
+ */
+void TiffFileTest::refresh()
+{
+    QFETCH(bool, useMemoryMap);
+    QFETCH(bool, growingFile);
+    QFETCH(bool, parseIfdsOnDemand);
+
+    TiffGeneratorOptions generatorOptions;
+    generatorOptions.pageCount = 5;
+    generatorOptions.arrayLength = 8;
+    const auto data = generate(generatorOptions);
+    TiffParserOptions options;
+    const auto offsets = TiffFile::fromData(data, options).scanIfdOffsets();
+    QCOMPARE(offsets.size(), 5);
+    const auto expected = dump(TiffFile::fromData(data, options));
+
+    // only the entry count of the last ifd has been written
+    const auto prefix = data.left(offsets.last() + 2);
+    const auto fileName =
+        QStringLiteral("refresh-%1.tif").arg(QString::fromLatin1(QTest::currentDataTag()));
+    QVERIFY(writeFile(fileName, prefix));
+
+    options.useMemoryMap = useMemoryMap;
+    options.growingFile = growingFile;
+    options.parseIfdsOnDemand = parseIfdsOnDemand;
+    TiffFile tiff(m_dir.filePath(fileName), options);
+    QCOMPARE(tiff.ifdCount(), 4);
+    QCOMPARE(tiff.hasError(), !growingFile);
+    QCOMPARE(tiff.refresh(), 0);
+
+    // a span taken before the file is mapped again stays valid while its ifd is kept
+    const auto ifd0 = tiff.ifd(0);
+    TiffValueSpan<quint32> stripOffsets;
+    foreach (const auto de, ifd0.ifdEntries()) {
+        if (de.tag() == 273)
+            stripOffsets = de.toUInt32Span();
+    }
+    QCOMPARE(stripOffsets.size(), qsizetype(generatorOptions.arrayLength));
+    QVector<quint32> stripOffsetValues;
+    for (qsizetype i = 0; i < stripOffsets.size(); ++i)
+        stripOffsetValues.append(stripOffsets[i]);
+
+    QFile file(m_dir.filePath(fileName));
+    QVERIFY(file.open(QIODevice::Append));
+    QCOMPARE(file.write(data.mid(prefix.size())), qint64(data.size() - prefix.size()));
+    file.close();
+
+    QCOMPARE(tiff.refresh(), 1);
+    QVERIFY2(!tiff.hasError(), qPrintable(tiff.errorString()));
+    QCOMPARE(tiff.ifdCount(), 5);
+    QCOMPARE(dump(tiff), expected);
+    QCOMPARE(tiff.refresh(), 0);
+
+    for (qsizetype i = 0; i < stripOffsets.size(); ++i)
+        QCOMPARE(stripOffsets[i], stripOffsetValues[i]);
+}
+
+/*
+ * Ifds restored from the cache keep their sub ifds when pages are appended.
+ */
+void TiffFileTest::refreshAfterCacheHit()
+{
+    TiffGeneratorOptions generatorOptions;
+    generatorOptions.pageCount = 5;
+    generatorOptions.subIfdCount = 2;
+    const auto data = generate(generatorOptions);
+    const auto expected = dump(TiffFile::fromData(data, TiffParserOptions()));
+    const auto offsets = TiffFile::fromData(data, TiffParserOptions()).scanIfdOffsets();
+    QCOMPARE(offsets.size(), 5);
+
+    // the fourth page isn't linked to the last one yet
+    const qint64 nextOffsetPos =
+        offsets[3] + 2 + 12 * qFromLittleEndian<quint16>(data.constData() + offsets[3]);
+    auto firstPages = data;
+    firstPages.replace(nextOffsetPos, 4, QByteArray(4, '\0'));
+    QVERIFY(writeFile("refresh-cache.tif", firstPages));
+
+    QTemporaryDir cacheDir;
+    QVERIFY(cacheDir.isValid());
+    TiffParseCache cache(cacheDir.path());
+    TiffParserOptions options;
+    options.cache = &cache;
+    const auto filePath = m_dir.filePath("refresh-cache.tif");
+    QVERIFY(cache.insert(TiffFile(filePath, options)));
+
+    TiffFile tiff(filePath, options);
+    QVERIFY(tiff.isLoadedFromCache());
+    QCOMPARE(tiff.ifdCount(), 4);
+
+    QFile file(filePath);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.seek(nextOffsetPos));
+    QCOMPARE(file.write(data.mid(nextOffsetPos, 4)), qint64(4));
+    file.close();
+
+    QCOMPARE(tiff.refresh(), 1);
+    QCOMPARE(tiff.ifdCount(), 5);
+    QCOMPARE(ifdTreeCount(tiff.ifds()), 15);
+    QCOMPARE(dump(tiff), expected);
+}
+
+void TiffFileTest::invalidGeneratorOptions_data()
+{
+    QTest::addColumn<int>("entriesPerIfd");
+    QTest::addColumn<int>("pageCount");
+    QTest::addColumn<int>("arrayLength");
+    QTest::addColumn<bool>("bigTiff");
+
+    QTest::newRow("negative") << -1 << 1 << 1 << false;
+    QTest::newRow("tag wrap") << 70000 << 1 << 1 << true;
+    QTest::newRow("classic offsets") << 12 << 1 << 100000000 << false;
+}
+
+void TiffFileTest::invalidGeneratorOptions()
+{
+    QFETCH(int, entriesPerIfd);
+    QFETCH(int, pageCount);
+    QFETCH(int, arrayLength);
+    QFETCH(bool, bigTiff);
+
+    TiffGeneratorOptions options;
+    options.entriesPerIfd = entriesPerIfd;
+    options.pageCount = pageCount;
+    options.arrayLength = arrayLength;
+    options.bigTiff = bigTiff;
+    TiffGenerator generator(options);
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    QVERIFY(!generator.write(&buffer));
+    QVERIFY(!generator.errorString().isEmpty());
+    QVERIFY(buffer.data().isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TiffFileTest)
+
+#include "tst_tifffile.moc"
@@ -0,0 +1,137 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#include "tifffileloader.h"
+#include "tiffgenerator.h"
+#include <QTemporaryDir>
+#include <QtTest>
+
+class TiffFileLoaderTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void signalOrder();
+    void cancel();
+
+private:
+    QTemporaryDir m_dir;
+    QString m_filePath;
+    QVector<qint64> m_ifdOffsets;
+};
+
+void TiffFileLoaderTest::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    TiffGeneratorOptions options;
+    options.pageCount = 2000;
+    options.subIfdCount = 1;
+    m_filePath = m_dir.filePath("pages.tif");
+    QVERIFY(TiffGenerator(options).writeFile(m_filePath));
+    m_ifdOffsets = TiffFile(m_filePath, TiffParserOptions()).scanIfdOffsets();
+    QCOMPARE(int(m_ifdOffsets.size()), options.pageCount);
+}
+
+/*
+ * opened() comes first, then the ifds in chain order, each batch followed by its
+ * progress, and finished() last.
+ */
+void TiffFileLoaderTest::signalOrder()
+{
+    TiffFileLoader loader;
+    QStringList events;
+    int ifdCount = 0;
+    connect(&loader, &TiffFileLoader::opened, this, [&](int count) {
+        events.append(QStringLiteral("opened %1").arg(count));
+        ifdCount = count;
+    });
+    connect(&loader, &TiffFileLoader::ifdParsed, this, [&](int index, const TiffIfd &ifd) {
+        // the ifd of index is the one which links to the next one in the chain
+        const qint64 next = index + 1 < m_ifdOffsets.size() ? m_ifdOffsets[index + 1] : 0;
+        events.append(QStringLiteral("ifd %1 %2").arg(index).arg(ifd.nextIfdOffset() == next));
+    });
+    connect(&loader, &TiffFileLoader::progressChanged, this, [&](int parsed, int count) {
+        events.append(QStringLiteral("progress %1 %2").arg(parsed).arg(count));
+    });
+    QSignalSpy finished(&loader, &TiffFileLoader::finished);
+
+    loader.open(m_filePath);
+    QVERIFY(loader.isRunning());
+    QVERIFY(finished.wait(30000));
+    QVERIFY(!loader.isRunning());
+    QVERIFY(!loader.isCanceled());
+    QVERIFY(loader.tiffFile());
+    QCOMPARE(ifdCount, int(m_ifdOffsets.size()));
+
+    QCOMPARE(events.first(), QStringLiteral("opened %1").arg(ifdCount));
+    int parsed = 0;
+    for (int i = 1; i < events.size(); ++i) {
+        const auto event = events[i];
+        if (event.startsWith(QLatin1String("ifd ")))
+            QCOMPARE(event, QStringLiteral("ifd %1 1").arg(parsed++));
+        else
+            QCOMPARE(event, QStringLiteral("progress %1 %2").arg(parsed).arg(ifdCount));
+    }
+    QCOMPARE(parsed, ifdCount);
+    QVERIFY(events.last().startsWith(QLatin1String("progress ")));
+    QCOMPARE(finished.count(), 1);
+}
+
+/*
+ * No signal of a canceled load is emitted, even the ones which were already on
+ * their way, and the loader can open a file again.
+ */
+void TiffFileLoaderTest::cancel()
+{
+    TiffFileLoader loader;
+    int parsed = 0;
+    connect(&loader, &TiffFileLoader::ifdParsed, this, [&]() {
+        if (++parsed == 1)
+            loader.cancel();
+    });
+    QSignalSpy progress(&loader, &TiffFileLoader::progressChanged);
+    QSignalSpy finished(&loader, &TiffFileLoader::finished);
+
+    loader.open(m_filePath);
+    QTRY_VERIFY(parsed > 0);
+    QVERIFY(!loader.isRunning());
+    QVERIFY(loader.isCanceled());
+    QTest::qWait(200);
+    QCOMPARE(parsed, 1);
+    QCOMPARE(progress.count(), 0);
+    QCOMPARE(finished.count(), 0);
+
+    // opening cancels the load in progress, only the last one finishes
+    loader.open(m_filePath);
+    loader.open(m_filePath);
+    QVERIFY(finished.wait(30000));
+    QTest::qWait(200);
+    QCOMPARE(finished.count(), 1);
+    QCOMPARE(parsed, 1 + int(m_ifdOffsets.size()));
+}
+
+QTEST_GUILESS_MAIN(TiffFileLoaderTest)
+
+#include "tst_tifffileloader.moc"
@@ -0,0 +1,102 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#include "tiffgenerator.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <cstdio>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("tiffgen");
+    app.setOrganizationName("dbzhang800");
+    app.setApplicationVersion(PROJECT_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Writes a synthetic tiff file, which only contains tags, for benchmarks and tests.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("output", "File to write.");
+    QCommandLineOption bigTiffOption("bigtiff", "Write a BigTIFF file.");
+    QCommandLineOption bigEndianOption("big-endian", "Write a big endian file.");
+    QCommandLineOption pagesOption("pages", "Number of pages.", "n", "1");
+    QCommandLineOption entriesOption("entries", "Entries per ifd.", "n", "12");
+    QCommandLineOption mixedTypesOption("mixed-types",
+                                        "Give the private tags values of every numeric type.");
+    QCommandLineOption arrayLengthOption("array-length", "Length of the strip arrays.", "n", "1");
+    QCommandLineOption subIfdsOption("subifds", "Sub ifds of each ifd.", "n", "0");
+    QCommandLineOption subIfdDepthOption("subifd-depth", "Levels of the sub ifd trees.", "n",
+                                         "1");
+    QCommandLineOption placementOption("placement",
+                                       "Placement of the values: inline, clustered or scattered.",
+                                       "placement", "clustered");
+    QCommandLineOption seedOption("seed", "Seed of the scattered placement.", "n", "1");
+    parser.addOptions({ bigTiffOption, bigEndianOption, pagesOption, entriesOption,
+                        mixedTypesOption, arrayLengthOption, subIfdsOption, subIfdDepthOption,
+                        placementOption, seedOption });
+    parser.process(app);
+
+    TiffGeneratorOptions options;
+    options.bigTiff = parser.isSet(bigTiffOption);
+    options.byteOrder =
+        parser.isSet(bigEndianOption) ? TiffFile::BigEndian : TiffFile::LittleEndian;
+
+    bool ok = true;
+    auto intValue = [&](const QCommandLineOption &option) {
+        bool valueOk = false;
+        const int value = parser.value(option).toInt(&valueOk);
+        ok = ok && valueOk && value >= 0;
+        return value;
+    };
+    options.pageCount = intValue(pagesOption);
+    options.entriesPerIfd = intValue(entriesOption);
+    options.mixedValueTypes = parser.isSet(mixedTypesOption);
+    options.arrayLength = intValue(arrayLengthOption);
+    options.subIfdCount = intValue(subIfdsOption);
+    options.subIfdDepth = intValue(subIfdDepthOption);
+    options.seed = static_cast<quint32>(intValue(seedOption));
+
+    const auto placement = parser.value(placementOption);
+    if (placement == QLatin1String("inline"))
+        options.valuePlacement = TiffGeneratorOptions::InlineValues;
+    else if (placement == QLatin1String("scattered"))
+        options.valuePlacement = TiffGeneratorOptions::ScatteredValues;
+    else if (placement != QLatin1String("clustered"))
+        ok = false;
+
+    if (!ok || parser.positionalArguments().size() != 1) {
+        fprintf(stderr, "%s\n", qPrintable(parser.helpText()));
+        return 2;
+    }
+
+    TiffGenerator generator(options);
+    if (!generator.writeFile(parser.positionalArguments().first())) {
+        fprintf(stderr, "Fail to write %s: %s\n", qPrintable(parser.positionalArguments().first()),
+                qPrintable(generator.errorString()));
+        return 1;
+    }
+    return 0;
+}
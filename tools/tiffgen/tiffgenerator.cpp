@@ -0,0 +1,514 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#include "tiffgenerator.h"
+#include <QBuffer>
+#include <QFile>
+#include <QVector>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+
+namespace {
+struct GeneratedEntry
+{
+    quint16 tag;
+    quint16 type;
+    QVector<quint64> values;
+};
+
+struct GeneratedIfd
+{
+    int level{ 0 }; // 0 for pages
+    int nextIfd{ -1 }; // index of the next ifd in the chain
+    QVector<int> subIfds;
+    qint64 offset{ 0 };
+    qint64 valuesOffset{ 0 };
+};
+
+enum {
+    BufferSize = 1024 * 1024,
+    // Private tags are numbered from FirstPrivateTag, so they stay sorted and unique.
+    FirstPrivateTag = 40000,
+    MaxPrivateTags = 65536 - FirstPrivateTag,
+    BaselineEntryCount = 12,
+    StripSize = 64
+};
+
+int typeSize(quint16 type)
+{
+    switch (type) {
+    case TiffIfdEntry::DT_Short:
+    case TiffIfdEntry::DT_SShort:
+        return 2;
+    case TiffIfdEntry::DT_Long:
+    case TiffIfdEntry::DT_SLong:
+    case TiffIfdEntry::DT_Ifd:
+    case TiffIfdEntry::DT_Float:
+        return 4;
+    case TiffIfdEntry::DT_Long8:
+    case TiffIfdEntry::DT_SLong8:
+    case TiffIfdEntry::DT_Ifd8:
+    case TiffIfdEntry::DT_Double:
+        return 8;
+    default:
+        return 1;
+    }
+}
+
+qint64 alignedSize(qint64 size)
+{
+    return (size + 1) & ~qint64(1);
+}
+
+/*
+ * Private entry \a index when the value types are mixed. All the bytes of the
+ * values differ, so they only read back right if they are swapped right: the
+ * values are the index, the low bytes of 0x0102030405060708 and -2, or the index
+ * + 0.5, -1.25 and 3e38 for floating point types.
+ */
+GeneratedEntry mixedTypeEntry(quint16 tag, int index)
+{
+    static const quint16 types[] = { TiffIfdEntry::DT_SByte, TiffIfdEntry::DT_SShort,
+                                     TiffIfdEntry::DT_SLong, TiffIfdEntry::DT_Float,
+                                     TiffIfdEntry::DT_Double, TiffIfdEntry::DT_Long8,
+                                     TiffIfdEntry::DT_SLong8, TiffIfdEntry::DT_Short };
+    GeneratedEntry entry{ tag, types[index % 8], {} };
+    if (entry.type == TiffIfdEntry::DT_Float) {
+        for (float value : { index + 0.5f, -1.25f, 3e38f }) {
+            quint32 bits;
+            memcpy(&bits, &value, sizeof(bits));
+            entry.values.append(bits);
+        }
+    } else if (entry.type == TiffIfdEntry::DT_Double) {
+        for (double value : { index + 0.5, -1.25, 3e38 }) {
+            quint64 bits;
+            memcpy(&bits, &value, sizeof(bits));
+            entry.values.append(bits);
+        }
+    } else {
+        // the values are truncated to the size of the type when they are written
+        entry.values = { quint64(index), Q_UINT64_C(0x0102030405060708), quint64(-2) };
+    }
+    return entry;
+}
+} // namespace
+
+class TiffGeneratorPrivate
+{
+public:
+    QString checkOptions() const;
+    void createIfds();
+    int appendIfd(int level);
+    QVector<GeneratedEntry> entries(const GeneratedIfd &ifd) const;
+    qint64 valuesSize(const QVector<GeneratedEntry> &entries) const;
+    void layoutIfds();
+
+    // sequential output, buffered
+    template <typename T>
+    void put(T value);
+    void putOffset(quint64 offset);
+    void putValues(const GeneratedEntry &entry);
+    void padTo(qint64 offset);
+    bool flush();
+
+    void writeTable(const GeneratedIfd &ifd);
+    void writeValues(const GeneratedIfd &ifd);
+
+    TiffGeneratorOptions options;
+    QString optionsError; // empty if the options are valid
+    QVector<GeneratedIfd> ifds;
+    QVector<int> valuesOrder;
+    int offsetSize{ 4 };
+    qint64 fileSize{ 0 };
+
+    QIODevice *device{ nullptr };
+    QByteArray buffer;
+    qint64 pos{ 0 };
+    bool hasError{ false };
+    QString errorString;
+};
+
+/*
+ * Returns why the options can't be written as a valid file, or an empty string.
+ */
+QString TiffGeneratorPrivate::checkOptions() const
+{
+    if (options.pageCount < 0 || options.entriesPerIfd < 0 || options.arrayLength < 0
+        || options.subIfdCount < 0 || options.subIfdDepth < 0)
+        return QStringLiteral("Counts must not be negative");
+    // This also keeps the entry count of classic tiff ifds below 65536.
+    if (options.entriesPerIfd > BaselineEntryCount + MaxPrivateTags)
+        return QStringLiteral("At most %1 entries per ifd are supported")
+            .arg(BaselineEntryCount + MaxPrivateTags);
+    if (!options.bigTiff
+        && StripSize * (qint64(options.arrayLength) + 1) > std::numeric_limits<quint32>::max())
+        return QStringLiteral("Strip offsets don't fit in a classic tiff file");
+
+    // pages and their sub ifd trees, which are indexed by int
+    qint64 treeSize = 1;
+    qint64 levelSize = 1;
+    for (int level = 1; level <= options.subIfdDepth && options.subIfdCount > 0; ++level) {
+        levelSize *= options.subIfdCount;
+        treeSize += levelSize;
+        if (treeSize > std::numeric_limits<int>::max())
+            break;
+    }
+    if (options.pageCount > 0 && treeSize > std::numeric_limits<int>::max() / options.pageCount)
+        return QStringLiteral("Too many ifds");
+    return QString();
+}
+
+/*
+ * The ifds are stored in file order: each page followed by its sub ifd tree.
+ */
+void TiffGeneratorPrivate::createIfds()
+{
+    ifds.clear();
+    int previousPage = -1;
+    for (int page = 0; page < options.pageCount; ++page) {
+        const int index = appendIfd(0);
+        if (previousPage != -1)
+            ifds[previousPage].nextIfd = index;
+        previousPage = index;
+    }
+}
+
+int TiffGeneratorPrivate::appendIfd(int level)
+{
+    const int index = ifds.size();
+    GeneratedIfd ifd;
+    ifd.level = level;
+    ifds.append(ifd);
+    if (level < options.subIfdDepth) {
+        for (int i = 0; i < options.subIfdCount; ++i) {
+            const int subIfd = appendIfd(level + 1);
+            ifds[index].subIfds.append(subIfd);
+        }
+    }
+    return index;
+}
+
+QVector<GeneratedEntry> TiffGeneratorPrivate::entries(const GeneratedIfd &ifd) const
+{
+    const quint16 longType = options.bigTiff ? TiffIfdEntry::DT_Long8 : TiffIfdEntry::DT_Long;
+    const int stripCount = qMax(options.arrayLength, 1);
+    QVector<quint64> stripOffsets(stripCount);
+    QVector<quint64> stripByteCounts(stripCount, StripSize);
+    for (int i = 0; i < stripCount; ++i)
+        stripOffsets[i] = 16 + quint64(i) * StripSize;
+
+    QVector<GeneratedEntry> entries{
+        { 254, TiffIfdEntry::DT_Long, { ifd.level ? 1u : 0u } },
+        { 256, TiffIfdEntry::DT_Long, { 64 } },
+        { 257, TiffIfdEntry::DT_Long, { quint64(stripCount) } },
+        { 258, TiffIfdEntry::DT_Short, { 8, 8, 8 } },
+        { 259, TiffIfdEntry::DT_Short, { 1 } },
+        { 262, TiffIfdEntry::DT_Short, { 2 } },
+        { 273, longType, stripOffsets },
+        { 277, TiffIfdEntry::DT_Short, { 3 } },
+        { 278, TiffIfdEntry::DT_Long, { 1 } },
+        { 279, longType, stripByteCounts },
+        { 284, TiffIfdEntry::DT_Short, { 1 } },
+        { 305, TiffIfdEntry::DT_Ascii, { 't', 'i', 'f', 'f', 'g', 'e', 'n', 0 } },
+    };
+    if (!ifd.subIfds.isEmpty()) {
+        GeneratedEntry subIfds{ TiffIfdEntry::T_SubIfd,
+                                options.bigTiff ? TiffIfdEntry::DT_Ifd8 : TiffIfdEntry::DT_Ifd,
+                                {} };
+        for (auto subIfd : ifd.subIfds)
+            subIfds.values.append(ifds[subIfd].offset);
+        entries.append(subIfds);
+    }
+    for (int i = 0; entries.size() < options.entriesPerIfd; ++i) {
+        const quint16 tag = FirstPrivateTag + i;
+        if (options.mixedValueTypes)
+            entries.append(mixedTypeEntry(tag, i));
+        else
+            entries.append({ tag, TiffIfdEntry::DT_Short, { quint64(i), 1, 2, 3 } });
+    }
+
+    if (options.valuePlacement == TiffGeneratorOptions::InlineValues) {
+        for (auto &entry : entries) {
+            const int maxCount = offsetSize / typeSize(entry.type);
+            if (entry.tag == TiffIfdEntry::T_SubIfd || entry.values.size() <= maxCount)
+                continue;
+            entry.values.resize(maxCount);
+            if (entry.type == TiffIfdEntry::DT_Ascii)
+                entry.values.last() = 0;
+        }
+    }
+    return entries;
+}
+
+qint64 TiffGeneratorPrivate::valuesSize(const QVector<GeneratedEntry> &entries) const
+{
+    qint64 size = 0;
+    for (const auto &entry : entries) {
+        const qint64 bytes = qint64(entry.values.size()) * typeSize(entry.type);
+        if (bytes > offsetSize)
+            size += alignedSize(bytes);
+    }
+    return size;
+}
+
+/*
+ * Computes the offsets of the entry tables and of the values, which only depend
+ * on the number of the entries and values, so the file can be written at once.
+ */
+void TiffGeneratorPrivate::layoutIfds()
+{
+    qint64 offset = options.bigTiff ? 16 : 8;
+    const int countSize = options.bigTiff ? 8 : 2;
+    const int entrySize = options.bigTiff ? 20 : 12;
+    const bool clustered = options.valuePlacement != TiffGeneratorOptions::ScatteredValues;
+
+    for (auto &ifd : ifds) {
+        const auto ifdEntries = entries(ifd);
+        ifd.offset = offset;
+        offset += countSize + ifdEntries.size() * entrySize + offsetSize;
+        if (clustered) {
+            ifd.valuesOffset = offset;
+            offset += valuesSize(ifdEntries);
+        }
+    }
+
+    valuesOrder.resize(ifds.size());
+    std::iota(valuesOrder.begin(), valuesOrder.end(), 0);
+    if (!clustered) {
+        std::mt19937 generator(options.seed);
+        std::shuffle(valuesOrder.begin(), valuesOrder.end(), generator);
+        for (auto index : valuesOrder) {
+            ifds[index].valuesOffset = offset;
+            offset += valuesSize(entries(ifds[index]));
+        }
+    }
+    fileSize = offset;
+}
+
+template <typename T>
+void TiffGeneratorPrivate::put(T value)
+{
+    if (options.byteOrder == TiffFile::BigEndian)
+        value = qToBigEndian(value);
+    else
+        value = qToLittleEndian(value);
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    pos += sizeof(T);
+    if (buffer.size() >= BufferSize)
+        flush();
+}
+
+void TiffGeneratorPrivate::putOffset(quint64 offset)
+{
+    if (options.bigTiff)
+        put<quint64>(offset);
+    else
+        put<quint32>(static_cast<quint32>(offset));
+}
+
+void TiffGeneratorPrivate::putValues(const GeneratedEntry &entry)
+{
+    for (auto value : entry.values) {
+        switch (typeSize(entry.type)) {
+        case 2:
+            put<quint16>(value);
+            break;
+        case 4:
+            put<quint32>(value);
+            break;
+        case 8:
+            put<quint64>(value);
+            break;
+        default:
+            put<quint8>(value);
+            break;
+        }
+    }
+}
+
+void TiffGeneratorPrivate::padTo(qint64 offset)
+{
+    while (pos < offset)
+        put<quint8>(0);
+}
+
+bool TiffGeneratorPrivate::flush()
+{
+    if (!hasError && device->write(buffer) != buffer.size()) {
+        hasError = true;
+        errorString = device->errorString();
+    }
+    buffer.clear();
+    return !hasError;
+}
+
+void TiffGeneratorPrivate::writeTable(const GeneratedIfd &ifd)
+{
+    const auto ifdEntries = entries(ifd);
+    padTo(ifd.offset);
+    if (options.bigTiff)
+        put<quint64>(ifdEntries.size());
+    else
+        put<quint16>(ifdEntries.size());
+
+    qint64 valueOffset = ifd.valuesOffset;
+    for (const auto &entry : ifdEntries) {
+        put<quint16>(entry.tag);
+        put<quint16>(entry.type);
+        putOffset(entry.values.size());
+        const qint64 bytes = qint64(entry.values.size()) * typeSize(entry.type);
+        if (bytes > offsetSize) {
+            putOffset(valueOffset);
+            valueOffset += alignedSize(bytes);
+        } else {
+            const qint64 end = pos + offsetSize;
+            putValues(entry);
+            padTo(end);
+        }
+    }
+    putOffset(ifd.nextIfd == -1 ? 0 : ifds[ifd.nextIfd].offset);
+}
+
+void TiffGeneratorPrivate::writeValues(const GeneratedIfd &ifd)
+{
+    padTo(ifd.valuesOffset);
+    foreach (const auto &entry, entries(ifd)) {
+        const qint64 bytes = qint64(entry.values.size()) * typeSize(entry.type);
+        if (bytes <= offsetSize)
+            continue;
+        putValues(entry);
+        if (bytes % 2)
+            put<quint8>(0);
+    }
+}
+
+/*!
+ * \class TiffGenerator
+ */
+TiffGenerator::TiffGenerator(const TiffGeneratorOptions &options)
+    : d(new TiffGeneratorPrivate)
+{
+    d->options = options;
+    d->offsetSize = options.bigTiff ? 8 : 4;
+    d->optionsError = d->checkOptions();
+    if (!d->optionsError.isEmpty())
+        return;
+    d->createIfds();
+    d->layoutIfds();
+    // offsets of classic tiff files are 32bit
+    if (!options.bigTiff && d->fileSize > std::numeric_limits<quint32>::max()) {
+        d->optionsError = QStringLiteral("File is too large for classic tiff, use BigTIFF");
+        d->ifds.clear();
+    }
+}
+
+TiffGenerator::~TiffGenerator()
+{
+}
+
+/*!
+ * Writes the file to \a device, which is written sequentially. Nothing is written
+ * if the options can't make a valid file, such as more entries per ifd than there
+ * are tags, or offsets which don't fit in a classic tiff file.
+ */
+bool TiffGenerator::write(QIODevice *device)
+{
+    d->device = device;
+    d->buffer.clear();
+    d->pos = 0;
+    d->hasError = !d->optionsError.isEmpty();
+    d->errorString = d->optionsError;
+    if (d->hasError)
+        return false;
+
+    // header
+    d->buffer.append(d->options.byteOrder == TiffFile::BigEndian ? "MM" : "II");
+    d->pos = 2;
+    if (d->options.bigTiff) {
+        d->put<quint16>(43);
+        d->put<quint16>(8);
+        d->put<quint16>(0);
+    } else {
+        d->put<quint16>(42);
+    }
+    d->putOffset(d->ifds.isEmpty() ? 0 : d->ifds.first().offset);
+
+    const bool clustered = d->options.valuePlacement != TiffGeneratorOptions::ScatteredValues;
+    foreach (const auto &ifd, d->ifds) {
+        d->writeTable(ifd);
+        if (clustered)
+            d->writeValues(ifd);
+        if (d->hasError)
+            return false;
+    }
+    if (!clustered) {
+        foreach (auto index, d->valuesOrder) {
+            d->writeValues(d->ifds[index]);
+            if (d->hasError)
+                return false;
+        }
+    }
+    return d->flush();
+}
+
+bool TiffGenerator::writeFile(const QString &filePath)
+{
+    if (!d->optionsError.isEmpty()) {
+        d->hasError = true;
+        d->errorString = d->optionsError;
+        return false;
+    }
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        d->hasError = true;
+        d->errorString = file.errorString();
+        return false;
+    }
+    return write(&file);
+}
+
+QByteArray TiffGenerator::generate()
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    write(&buffer);
+    return buffer.data();
+}
+
+/*!
+ * Returns the number of ifds, sub ifds included.
+ */
+int TiffGenerator::ifdCount() const
+{
+    return d->ifds.size();
+}
+
+QString TiffGenerator::errorString() const
+{
+    return d->errorString;
+}
@@ -0,0 +1,83 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#pragma once
+
+#include "tifffile.h"
+#include <QScopedPointer>
+#include <QString>
+
+class QIODevice;
+class TiffGeneratorPrivate;
+
+struct TiffGeneratorOptions
+{
+    enum ValuePlacement {
+        // Arrays are shortened until their values fit in the entries, only SubIFDs
+        // offsets may still be written out of line.
+        InlineValues,
+        // Out of line values are written right after the entry table of their ifd.
+        ClusteredValues,
+        // All the entry tables are written first, followed by the values of the ifds
+        // in a shuffled order.
+        ScatteredValues
+    };
+
+    bool bigTiff{ false };
+    TiffFile::ByteOrder byteOrder{ TiffFile::LittleEndian };
+    int pageCount{ 1 };
+    // Private tags are added after the baseline tags to reach this count.
+    int entriesPerIfd{ 12 };
+    // Private tags cycle through the numeric types, from SBYTE to SLONG8, instead of
+    // all being SHORT, so that the byte order of every type is exercised.
+    bool mixedValueTypes{ false };
+    // Length of the StripOffsets and StripByteCounts arrays.
+    int arrayLength{ 1 };
+    // Sub ifds of each ifd, and the nesting level of the sub ifd trees.
+    int subIfdCount{ 0 };
+    int subIfdDepth{ 1 };
+    ValuePlacement valuePlacement{ ClusteredValues };
+    // Seed of the shuffled order of ScatteredValues, files are reproducible for a seed.
+    quint32 seed{ 1 };
+};
+
+/*!
+ * Writes synthetic tiff files, only the tags are written, not the image data.
+ */
+class TiffGenerator
+{
+public:
+    explicit TiffGenerator(const TiffGeneratorOptions &options = TiffGeneratorOptions());
+    ~TiffGenerator();
+
+    bool write(QIODevice *device);
+    bool writeFile(const QString &filePath);
+    QByteArray generate();
+
+    int ifdCount() const;
+    QString errorString() const;
+
+private:
+    QScopedPointer<TiffGeneratorPrivate> d;
+};
@@ -0,0 +1,482 @@
+/****************************************************************************
+** Copyright (c) 2018 Debao Zhang <hello@debao.me>
+** All right reserved.
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+#include "tifffile.h"
+#include "tifftrace.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QThread>
+#include <QThreadPool>
+#include <cstdio>
+#include <limits>
+#include <memory>
+
+namespace {
+enum ExitCode { ExitSuccess = 0, ExitFileError = 1, ExitUsageError = 2 };
+
+struct DumpOptions
+{
+    TiffParserOptions parserOptions;
+    bool json{ false };
+    int maxValues{ 32 }; // 0 means all values
+};
+
+QMutex g_outputMutex;
+
+// Each file is written at once, so the output of concurrent files isn't interleaved.
+void writeOutput(const QByteArray &bytes)
+{
+    QMutexLocker locker(&g_outputMutex);
+    fwrite(bytes.constData(), 1, bytes.size(), stdout);
+    fflush(stdout);
+}
+
+qsizetype shownValueCount(qsizetype count, int maxValues)
+{
+    return maxValues > 0 ? qMin<qsizetype>(count, maxValues) : count;
+}
+
+// The strings of an ASCII value, without their terminating NUL.
+QStringList asciiStrings(const TiffIfdEntry &de)
+{
+    QStringList strings;
+    foreach (const auto v, de.values()) {
+        auto string = v.toString();
+        if (string.endsWith(QChar(0)))
+            string.chop(1);
+        strings.append(string);
+    }
+    return strings;
+}
+
+// Quotes, backslashes and control characters are escaped so each entry stays on one line.
+QString quotedString(const QString &string)
+{
+    QString quoted(QLatin1Char('"'));
+    for (const auto c : string) {
+        switch (c.unicode()) {
+        case '"':
+            quoted.append(QLatin1String("\\\""));
+            break;
+        case '\\':
+            quoted.append(QLatin1String("\\\\"));
+            break;
+        case '\n':
+            quoted.append(QLatin1String("\\n"));
+            break;
+        case '\r':
+            quoted.append(QLatin1String("\\r"));
+            break;
+        case '\t':
+            quoted.append(QLatin1String("\\t"));
+            break;
+        default:
+            if (c.unicode() < 0x20 || c.unicode() == 0x7f)
+                quoted.append(QStringLiteral("\\x%1").arg(c.unicode(), 2, 16, QLatin1Char('0')));
+            else
+                quoted.append(c);
+        }
+    }
+    quoted.append(QLatin1Char('"'));
+    return quoted;
+}
+
+template <typename T>
+void appendJsonValues(QJsonArray *array, const TiffValueSpan<T> &span, int maxValues)
+{
+    const auto count = shownValueCount(span.size(), maxValues);
+    for (qsizetype i = 0; i < count; ++i)
+        array->append(static_cast<double>(span[i]));
+}
+
+template <typename T>
+void appendTextValues(QStringList *list, const TiffValueSpan<T> &span, int maxValues)
+{
+    const auto count = shownValueCount(span.size(), maxValues);
+    for (qsizetype i = 0; i < count; ++i)
+        list->append(QString::number(span[i]));
+}
+
+QJsonArray jsonValues(const TiffIfdEntry &de, int maxValues)
+{
+    QJsonArray array;
+    switch (de.type()) {
+    case TiffIfdEntry::DT_Ascii: {
+        const auto strings = asciiStrings(de);
+        const auto count = shownValueCount(strings.size(), maxValues);
+        for (qsizetype i = 0; i < count; ++i)
+            array.append(strings[i]);
+        break;
+    }
+    case TiffIfdEntry::DT_Undefined: {
+        auto span = de.toUInt8Span();
+        const auto count = shownValueCount(span.size(), maxValues);
+        array.append(QString::fromLatin1(
+            QByteArray::fromRawData(reinterpret_cast<const char *>(span.data()), count).toHex()));
+        break;
+    }
+    case TiffIfdEntry::DT_Rational:
+    case TiffIfdEntry::DT_SRational: {
+        const auto count = shownValueCount(de.valueCount(), maxValues);
+        for (qsizetype i = 0; i < count; ++i) {
+            const auto rational = de.rationalAt(i);
+            array.append(QJsonArray{ rational.numerator, rational.denominator });
+        }
+        break;
+    }
+    case TiffIfdEntry::DT_Long8:
+    case TiffIfdEntry::DT_Ifd8: {
+        // 64bit values are written as integers, exact up to the qint64 range
+        auto span = de.toUInt64Span();
+        const auto count = shownValueCount(span.size(), maxValues);
+        for (qsizetype i = 0; i < count; ++i)
+            array.append(span[i] > quint64(std::numeric_limits<qint64>::max())
+                                 ? QJsonValue(static_cast<double>(span[i]))
+                                 : QJsonValue(static_cast<qint64>(span[i])));
+        break;
+    }
+    case TiffIfdEntry::DT_SLong8: {
+        auto span = de.toInt64Span();
+        const auto count = shownValueCount(span.size(), maxValues);
+        for (qsizetype i = 0; i < count; ++i)
+            array.append(QJsonValue(span[i]));
+        break;
+    }
+    case TiffIfdEntry::DT_Byte:
+        appendJsonValues(&array, de.toUInt8Span(), maxValues);
+        break;
+    case TiffIfdEntry::DT_SByte:
+        appendJsonValues(&array, de.toInt8Span(), maxValues);
+        break;
+    case TiffIfdEntry::DT_Short:
+        appendJsonValues(&array, de.toUInt16Span(), maxValues);
+        break;
+    case TiffIfdEntry::DT_SShort:
+        appendJsonValues(&array, de.toInt16Span(), maxValues);
+        break;
+    case TiffIfdEntry::DT_Long:
+    case TiffIfdEntry::DT_Ifd:
+        appendJsonValues(&array, de.toUInt32Span(), maxValues);
+        break;
+    case TiffIfdEntry::DT_SLong:
+        appendJsonValues(&array, de.toInt32Span(), maxValues);
+        break;
+    case TiffIfdEntry::DT_Float:
+        appendJsonValues(&array, de.toFloatSpan(), maxValues);
+        break;
+    case TiffIfdEntry::DT_Double:
+        appendJsonValues(&array, de.toDoubleSpan(), maxValues);
+        break;
+    default:
+        break;
+    }
+    return array;
+}
+
+QString textValues(const TiffIfdEntry &de, int maxValues)
+{
+    QStringList list;
+    switch (de.type()) {
+    case TiffIfdEntry::DT_Ascii: {
+        const auto strings = asciiStrings(de);
+        const auto count = shownValueCount(strings.size(), maxValues);
+        for (qsizetype i = 0; i < count; ++i)
+            list.append(quotedString(strings[i]));
+        break;
+    }
+    case TiffIfdEntry::DT_Undefined: {
+        auto span = de.toUInt8Span();
+        const auto count = shownValueCount(span.size(), maxValues);
+        for (qsizetype i = 0; i < count; ++i)
+            list.append(QStringLiteral("%1").arg(uint(span[i]), 2, 16, QLatin1Char('0')));
+        break;
+    }
+    case TiffIfdEntry::DT_Rational:
+    case TiffIfdEntry::DT_SRational: {
+        const auto count = shownValueCount(de.valueCount(), maxValues);
+        for (qsizetype i = 0; i < count; ++i) {
+            const auto rational = de.rationalAt(i);
+            list.append(QStringLiteral("%1/%2").arg(rational.numerator).arg(rational.denominator));
+        }
+        break;
+    }
+    case TiffIfdEntry::DT_Byte:
+        appendTextValues(&list, de.toUInt8Span(), maxValues);
+        break;
+    case TiffIfdEntry::DT_SByte:
+        appendTextValues(&list, de.toInt8Span(), maxValues);
+        break;
+    case TiffIfdEntry::DT_Short:
+        appendTextValues(&list, de.toUInt16Span(), maxValues);
+        break;
+    case TiffIfdEntry::DT_SShort:
+        appendTextValues(&list, de.toInt16Span(), maxValues);
+        break;
+    case TiffIfdEntry::DT_Long:
+    case TiffIfdEntry::DT_Ifd:
+        appendTextValues(&list, de.toUInt32Span(), maxValues);
+        break;
+    case TiffIfdEntry::DT_SLong:
+        appendTextValues(&list, de.toInt32Span(), maxValues);
+        break;
+    case TiffIfdEntry::DT_Long8:
+    case TiffIfdEntry::DT_Ifd8:
+        appendTextValues(&list, de.toUInt64Span(), maxValues);
+        break;
+    case TiffIfdEntry::DT_SLong8:
+        appendTextValues(&list, de.toInt64Span(), maxValues);
+        break;
+    case TiffIfdEntry::DT_Float:
+        appendTextValues(&list, de.toFloatSpan(), maxValues);
+        break;
+    case TiffIfdEntry::DT_Double:
+        appendTextValues(&list, de.toDoubleSpan(), maxValues);
+        break;
+    default:
+        break;
+    }
+
+    auto text = list.join(QLatin1Char(' '));
+    if (maxValues > 0 && de.valueCount() > maxValues && de.type() != TiffIfdEntry::DT_Ascii)
+        text.append(QStringLiteral(" ..."));
+    return text;
+}
+
+QJsonObject jsonIfd(const TiffIfd &ifd, const DumpOptions &options)
+{
+    QJsonArray entries;
+    foreach (const auto de, ifd.ifdEntries()) {
+        QJsonObject entry{
+            { QStringLiteral("tag"), de.tag() },
+            { QStringLiteral("name"), de.tagName() },
+            { QStringLiteral("type"), de.typeName() },
+            { QStringLiteral("count"), static_cast<qint64>(de.count()) },
+            { QStringLiteral("values"), jsonValues(de, options.maxValues) },
+        };
+        auto vd = de.valueDescription();
+        if (!vd.isEmpty())
+            entry.insert(QStringLiteral("description"), vd);
+        entries.append(entry);
+    }
+
+    QJsonObject object{ { QStringLiteral("entries"), entries },
+                        { QStringLiteral("nextIfdOffset"), ifd.nextIfdOffset() } };
+    if (!ifd.subIfds().isEmpty()) {
+        QJsonArray subIfds;
+        foreach (const auto subIfd, ifd.subIfds())
+            subIfds.append(jsonIfd(subIfd, options));
+        object.insert(QStringLiteral("subIfds"), subIfds);
+    }
+    return object;
+}
+
+void appendTextIfd(QString *text, const TiffIfd &ifd, const QString &title, int level,
+                   const DumpOptions &options)
+{
+    const QString indent(level * 2, QLatin1Char(' '));
+    text->append(QStringLiteral("%1%2: next %3 (0x%4)\n")
+                     .arg(indent, title)
+                     .arg(ifd.nextIfdOffset())
+                     .arg(ifd.nextIfdOffset(), 0, 16));
+    foreach (const auto de, ifd.ifdEntries()) {
+        text->append(QStringLiteral("%1%2 (%3) %4 (%5) %6<%7>")
+                         .arg(indent, de.tagName())
+                         .arg(de.tag())
+                         .arg(de.typeName())
+                         .arg(de.type())
+                         .arg(de.count())
+                         .arg(textValues(de, options.maxValues)));
+        auto vd = de.valueDescription();
+        if (!vd.isEmpty())
+            text->append(QStringLiteral(" [%1]").arg(vd));
+        text->append(QLatin1Char('\n'));
+    }
+
+    const auto subIfds = ifd.subIfds();
+    for (int i = 0; i < subIfds.size(); ++i)
+        appendTextIfd(text, subIfds[i], QStringLiteral("SubIFD %1").arg(i), level + 1, options);
+}
+
+/*
+ * Parses one file and writes its record, returns false if the file has errors.
+ */
+bool dumpFile(const QString &filePath, const DumpOptions &options)
+{
+    TIFF_TRACE_SPAN("dumpFile");
+    // "-" is the standard input, which is parsed as it arrives when it's a pipe
+    QFile input;
+    std::unique_ptr<TiffFile> tiffFile;
+    if (filePath == QLatin1String("-")) {
+        input.open(stdin, QIODevice::ReadOnly);
+        tiffFile.reset(new TiffFile(&input, options.parserOptions));
+    } else {
+        tiffFile.reset(new TiffFile(filePath, options.parserOptions));
+    }
+    const TiffFile &tiff = *tiffFile;
+    // the ifds parsed before an error is found are still written, with the error
+    const auto ifds = tiff.ifds();
+
+    if (options.json) {
+        QJsonObject object{ { QStringLiteral("file"), filePath } };
+        if (!tiff.headerBytes().isEmpty()) {
+            object.insert(QStringLiteral("byteOrder"),
+                          tiff.byteOrder() == TiffFile::BigEndian ? QStringLiteral("BigEndian")
+                                                                  : QStringLiteral("LittleEndian"));
+            object.insert(QStringLiteral("bigTiff"), tiff.isBigTiff());
+            object.insert(QStringLiteral("ifd0Offset"), tiff.ifd0Offset());
+            QJsonArray ifdArray;
+            foreach (const auto ifd, ifds)
+                ifdArray.append(jsonIfd(ifd, options));
+            object.insert(QStringLiteral("ifds"), ifdArray);
+        }
+        if (tiff.hasError())
+            object.insert(QStringLiteral("error"), tiff.errorString());
+        writeOutput(QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n');
+        return !tiff.hasError();
+    }
+
+    QString text = QStringLiteral("%1:\n").arg(filePath);
+    if (!tiff.headerBytes().isEmpty()) {
+        text.append(QStringLiteral("Magic: %1 <%2> Version: 0x%3%4\n")
+                        .arg(QString::fromLatin1(tiff.headerBytes().left(2)))
+                        .arg(tiff.byteOrder() == TiffFile::BigEndian ? "big-endian"
+                                                                     : "little-endian")
+                        .arg(tiff.version(), 0, 16)
+                        .arg(tiff.isBigTiff() ? " (BigTIFF)" : ""));
+        const auto ifdOffsets = tiff.scanIfdOffsets();
+        for (int i = 0; i < ifds.size(); ++i) {
+            appendTextIfd(&text, ifds[i],
+                          QStringLiteral("Directory %1: offset %2 (0x%3)")
+                              .arg(i)
+                              .arg(ifdOffsets.value(i))
+                              .arg(ifdOffsets.value(i), 0, 16),
+                          0, options);
+        }
+    }
+    if (tiff.hasError())
+        text.append(QStringLiteral("Error: %1\n").arg(tiff.errorString()));
+    text.append(QLatin1Char('\n'));
+    writeOutput(text.toUtf8());
+    return !tiff.hasError();
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("tifftags");
+    app.setOrganizationName("dbzhang800");
+    app.setApplicationVersion(PROJECT_VERSION);
+
+    QLoggingCategory::setFilterRules("*.debug=false");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Dumps the tags of tiff files. Files are parsed concurrently, and each file is\n"
+        "written to stdout as soon as it is parsed, so the order of the output may differ\n"
+        "from the order of the inputs.\n\n"
+        "Exit status: 0 if all files were parsed, 1 if any file has errors, 2 on usage errors.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument(
+        "paths", "Tiff files, directories to search for tiff files, or - for stdin.", "paths...");
+    QCommandLineOption formatOption({ "f", "format" }, "Output format, text or jsonl.", "format",
+                                    "text");
+    QCommandLineOption jobsOption({ "j", "jobs" }, "Number of files parsed at the same time.", "n",
+                                  QString::number(QThread::idealThreadCount()));
+    QCommandLineOption recursiveOption({ "r", "recursive" }, "Search directories recursively.");
+    QCommandLineOption maxValuesOption("max-values",
+                                       "Values shown per entry, 0 to show all of them.", "n",
+                                       "32");
+    QCommandLineOption noSubIfdsOption("no-subifds", "Don't parse sub ifds.");
+    QCommandLineOption memoryMapOption("mmap", "Map the files into memory.");
+    QCommandLineOption traceOption("trace", "Write a trace of parsing the files.", "out.json");
+    parser.addOptions({ formatOption, jobsOption, recursiveOption, maxValuesOption,
+                        noSubIfdsOption, memoryMapOption, traceOption });
+    parser.process(app);
+    if (parser.isSet(traceOption))
+        TiffTrace::start();
+
+    DumpOptions options;
+    options.parserOptions.parserSubIfds = !parser.isSet(noSubIfdsOption);
+    options.parserOptions.useMemoryMap = parser.isSet(memoryMapOption);
+
+    bool ok = true;
+    const auto format = parser.value(formatOption);
+    options.json = format == QLatin1String("jsonl");
+    options.maxValues = parser.value(maxValuesOption).toInt(&ok);
+    const int jobs = ok ? parser.value(jobsOption).toInt(&ok) : 0;
+    if (!ok || jobs < 1 || options.maxValues < 0
+        || (!options.json && format != QLatin1String("text"))
+        || parser.positionalArguments().isEmpty()) {
+        fprintf(stderr, "%s\n", qPrintable(parser.helpText()));
+        return ExitUsageError;
+    }
+    // When all the values are written, they are read in file order with the ifds,
+    // otherwise only the values shown are loaded.
+    options.parserOptions.prefetchValues = options.maxValues == 0;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(jobs);
+    QAtomicInt failedCount;
+    auto startDump = [&](const QString &filePath) {
+        pool.start([&options, &failedCount, filePath]() {
+            if (!dumpFile(filePath, options))
+                failedCount.fetchAndAddRelaxed(1);
+        });
+    };
+
+    const QStringList nameFilters{ "*.tif", "*.tiff", "*.btf", "*.tf8" };
+    foreach (const auto path, parser.positionalArguments()) {
+        QFileInfo info(path);
+        if (path == QLatin1String("-")) {
+            startDump(path);
+        } else if (!info.exists()) {
+            fprintf(stderr, "%s: No such file or directory\n", qPrintable(path));
+            failedCount.fetchAndAddRelaxed(1);
+        } else if (info.isDir()) {
+            QDirIterator it(path, nameFilters, QDir::Files,
+                            parser.isSet(recursiveOption) ? QDirIterator::Subdirectories
+                                                          : QDirIterator::NoIteratorFlags);
+            while (it.hasNext())
+                startDump(it.next());
+        } else {
+            startDump(path);
+        }
+    }
+    pool.waitForDone();
+
+    if (parser.isSet(traceOption) && !TiffTrace::writeFile(parser.value(traceOption)))
+        fprintf(stderr, "Fail to write trace file %s\n", qPrintable(parser.value(traceOption)));
+    return failedCount.loadRelaxed() ? ExitFileError : ExitSuccess;
+}